@@ -0,0 +1,109 @@
+/* the big flag table of the sieve under each placement policy (big_alloc.h): time of
+   allocation + zeroing, time of the sieve, dTLB load misses and huge pages in use
+
+   build: g++ -O2 -fopenmp alloc_bench.cpp -o alloc_bench
+   usage: ./alloc_bench [n] [policy ...]     n numbers (default 5 * 10^8), one byte each;
+                                             policies: plain first-touch thp hugetlb interleave */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "sieve.h"
+#include "big_alloc.h"
+
+using namespace std;
+
+const size_t bench_chunk = 32 << 20;	// bytes of the table per loop iteration
+
+/* kB of AnonHugePages of this process */
+
+long huge_kb() {
+	FILE *f = fopen("/proc/self/smaps_rollup", "r");
+	if (!f)
+		return -1;
+	char line[256];
+	long kb = -1;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+			break;
+	fclose(f);
+	return kb;
+}
+
+/* crossed[i] = 1 for composite i; every thread sieves its chunks (static schedule, as
+   first_touch) with all primes up to sqrt(n) */
+
+uLL sieve(char *crossed, uLL n, const vector<unsigned> &base, uint64_t &misses, bool &counted) {
+	long long pieces = (long long) ((n + bench_chunk - 1) / bench_chunk), i;
+	uLL primes = 0;
+	bool all = true;	// every thread has its counter
+	misses = 0;
+#pragma omp parallel reduction(+:primes, misses) reduction(&&:all)
+	{
+		dtlb_counter c;
+		all = c.ok();
+		c.start();
+#pragma omp for schedule(static)
+		for (i = 0; i < pieces; ++i) {
+			uLL lo = i * bench_chunk, hi = lo + bench_chunk < n ? lo + bench_chunk : n;
+			for (size_t k = 0; k < base.size(); ++k) {
+				uLL p = base[k], j = p * p;
+				if (j >= hi)
+					break;
+				if (j < lo)
+					j = (lo + p - 1) / p * p;
+				for (; j < hi; j += p)
+					crossed[j] = 1;
+			}
+			for (uLL m = lo < 2 ? 2 : lo; m < hi; ++m)
+				primes += !crossed[m];
+		}
+		misses += c.stop();
+	}
+	counted = all;
+	return primes;
+}
+
+int main(int argc, char **argv) {
+	uLL n = argc > 1 ? strtoull(argv[1], NULL, 10) : 500000000ULL;
+	vector<alloc_policy> policies;
+	for (int a = 2; a < argc; ++a)
+		for (int p = 0; p <= alloc_interleave; ++p)
+			if (string(argv[a]) == alloc_policy_names[p])
+				policies.push_back((alloc_policy) p);
+	if (policies.empty())
+		for (int p = 0; p <= alloc_interleave; ++p)
+			policies.push_back((alloc_policy) p);
+	vector<unsigned> base = small_primes((unsigned) isqrt(n));
+	cout << "threads: " << omp_get_max_threads() << ", NUMA nodes mask: " << numa_online_mask()
+	     << ", table: " << n / (1 << 20) << " MB" << endl;
+	for (size_t i = 0; i < policies.size(); ++i) {
+		double start = omp_get_wtime();
+		big_buffer b = big_alloc(n, policies[i], bench_chunk);
+		double allocated = omp_get_wtime();
+		if (!b.p) {
+			cout << alloc_policy_names[policies[i]] << ": allocation failed" << endl;
+			continue;
+		}
+		long huge = huge_kb();
+		uint64_t misses;
+		bool counted;
+		uLL primes = sieve((char *) b.p, n, base, misses, counted);
+		double stop = omp_get_wtime();
+		printf("%-12s", alloc_policy_names[policies[i]]);
+		if (b.policy != policies[i])
+			printf(" (as %s)", alloc_policy_names[b.policy]);
+		printf("  alloc+zero %.3f  sieve %.3f (%.1f M/s)  primes %llu  huge pages %ld MB  dTLB misses ",
+			allocated - start, stop - allocated, n / (stop - allocated) / 1e6, primes, huge / 1024);
+		if (counted)
+			printf("%llu\n", (uLL) misses);
+		else
+			printf("n/a\n");
+		big_free(b);
+	}
+	return 0;
+}
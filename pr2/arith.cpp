@@ -0,0 +1,218 @@
+/* arithmetic functions over ranges (arith.h), segments in parallel
+
+   build: g++ -O2 -fopenmp arith.cpp -o arith
+   usage: ./arith sums lo hi          sums of phi, mu, sigma0, sigma1 over [lo, hi)
+          ./arith list lo hi          n phi(n) mu(n) sigma0(n) sigma1(n), one per line
+          ./arith mertens x [points]  M(x) and M at points evenly spaced up to x
+          ./arith check hi            every n < hi against trial division          */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "sieve.h"
+#include "arith.h"
+
+using namespace std;
+
+typedef unsigned __int128 u128;
+
+string to_string(u128 v) {
+	string s;
+	do {
+		s.insert(s.begin(), (char) ('0' + (int) (v % 10)));
+		v /= 10;
+	} while (v);
+	return s;
+}
+
+struct sums {
+	u128 phi, sigma0, sigma1;
+	long long mu;
+};
+
+void sum_range(uLL lo, uLL hi, sums &r) {
+	vector<unsigned> base = small_primes((unsigned) isqrt(hi - 1));
+	long long segments = (long long) ((hi - lo + arith_segment - 1) / arith_segment);
+	u128 phi = 0, sigma0 = 0, sigma1 = 0;
+	long long mu = 0;
+	double start = omp_get_wtime();
+#pragma omp parallel
+	{
+		arith_segment_values s;
+		u128 tphi = 0, tsigma0 = 0, tsigma1 = 0;
+		long long tmu = 0;
+		long long k;
+#pragma omp for schedule(dynamic)
+		for (k = 0; k < segments; ++k) {
+			uLL a = lo + k * arith_segment;
+			s.compute(a, hi - a > arith_segment ? a + arith_segment : hi, base);
+			for (size_t i = 0; i < s.size(); ++i) {
+				tphi += s.phi[i];
+				tmu += s.mu[i];
+				tsigma0 += s.sigma0[i];
+				tsigma1 += s.sigma1[i];
+			}
+		}
+#pragma omp critical
+		{
+			phi += tphi;
+			mu += tmu;
+			sigma0 += tsigma0;
+			sigma1 += tsigma1;
+		}
+	}
+	cout << "Sums over " << segments << " segments: " << omp_get_wtime() - start << endl;
+	r.phi = phi;
+	r.mu = mu;
+	r.sigma0 = sigma0;
+	r.sigma1 = sigma1;
+}
+
+/* Mertens function: sum of mu per segment in parallel, then the prefix sums - a batch
+   of mertens_batch segments per thread at a time, the prefix carried from batch to
+   batch, so the memory does not grow with x */
+
+const long long mertens_batch = 64;
+
+void mertens(uLL x, uLL points) {
+	vector<unsigned> base = small_primes((unsigned) isqrt(x));
+	long long segments = (long long) (x / arith_segment + 1);
+	long long batch = mertens_batch * omp_get_max_threads();
+	vector<long long> total(batch);
+	double start = omp_get_wtime();
+	uLL step = points ? x / points : 0;
+	long long m = 0;
+	arith_segment_values s;
+	for (long long from = 0; from < segments; from += batch) {
+		long long to = from + batch < segments ? from + batch : segments;
+#pragma omp parallel
+		{
+			arith_segment_values t;
+			long long k;
+#pragma omp for schedule(dynamic)
+			for (k = from; k < to; ++k) {
+				uLL a = k * arith_segment;
+				t.compute(a, x + 1 - a > arith_segment ? a + arith_segment : x + 1, base, fn_mu);
+				long long sum = 0;
+				for (size_t i = 0; i < t.mu.size(); ++i)
+					sum += t.mu[i];
+				total[k - from] = sum;
+			}
+		}
+		// M at a point inside segment k: prefix of the segments before + part of k
+		for (long long k = from; k < to; ++k) {
+			uLL a = k * arith_segment, b = a + arith_segment < x + 1 ? a + arith_segment : x + 1;
+			if (step) {
+				uLL first = (a + step - 1) / step * step;
+				if (first == 0)
+					first = step;
+				if (first < b) {
+					s.compute(a, b, base, fn_mu);
+					long long t = m;
+					uLL next = first;
+					for (size_t i = 0; i < s.mu.size(); ++i) {
+						t += s.mu[i];
+						if (s.lo + i == next) {
+							cout << "M(" << next << ") = " << t << endl;
+							next += step;
+						}
+					}
+				}
+			}
+			m += total[k - from];
+		}
+	}
+	cout << "M(" << x << ") = " << m << endl;
+	cout << "Mertens over " << segments << " segments: " << omp_get_wtime() - start << endl;
+}
+
+void list(uLL lo, uLL hi) {
+	vector<unsigned> base = small_primes((unsigned) isqrt(hi - 1));
+	arith_segment_values s;
+	for (uLL a = lo; a < hi; a += arith_segment) {
+		s.compute(a, hi - a > arith_segment ? a + arith_segment : hi, base);
+		for (size_t i = 0; i < s.size(); ++i)
+			printf("%llu %llu %d %u %llu\n", s.lo + i, s.phi[i], s.mu[i], s.sigma0[i], s.sigma1[i]);
+	}
+}
+
+/* phi, mu, sigma0, sigma1 of n by trial division */
+
+void naive(uLL n, uLL &phi, int &mu, uLL &sigma0, uLL &sigma1) {
+	phi = 1;
+	mu = 1;
+	sigma0 = sigma1 = 1;
+	for (uLL p = 2; p * p <= n; ++p) {
+		if (n % p)
+			continue;
+		uLL pe = 1, sum = 1;
+		unsigned e = 0;
+		while (n % p == 0) {
+			n /= p;
+			pe *= p;
+			sum += pe;
+			++e;
+		}
+		phi *= pe / p * (p - 1);
+		mu = e > 1 ? 0 : -mu;
+		sigma0 *= e + 1;
+		sigma1 *= sum;
+	}
+	if (n > 1) {
+		phi *= n - 1;
+		mu = -mu;
+		sigma0 *= 2;
+		sigma1 *= n + 1;
+	}
+}
+
+bool check(uLL hi) {
+	vector<unsigned> base = small_primes((unsigned) isqrt(hi - 1));
+	arith_segment_values s;
+	uLL errors = 0;
+	for (uLL a = 1; a < hi; a += arith_segment) {
+		s.compute(a, hi - a > arith_segment ? a + arith_segment : hi, base);
+		for (size_t i = 0; i < s.size(); ++i) {
+			uLL phi, sigma0, sigma1;
+			int mu;
+			naive(s.lo + i, phi, mu, sigma0, sigma1);
+			if (phi != s.phi[i] || mu != s.mu[i] || sigma0 != s.sigma0[i] || sigma1 != s.sigma1[i])
+				if (errors++ < 10)
+					cout << "mismatch at " << s.lo + i << endl;
+		}
+	}
+	cout << errors << " mismatches below " << hi << endl;
+	return errors == 0;
+}
+
+int main(int argc, char **argv) {
+	string mode = argc > 1 ? argv[1] : "";
+	uLL a = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+	uLL b = argc > 3 ? strtoull(argv[3], NULL, 10) : 0;
+	if (mode == "sums" && argc > 3 && a < b) {
+		sums r;
+		sum_range(a, b, r);
+		cout << "sum phi    = " << to_string(r.phi) << endl;
+		cout << "sum mu     = " << r.mu << endl;
+		cout << "sum sigma0 = " << to_string(r.sigma0) << endl;
+		cout << "sum sigma1 = " << to_string(r.sigma1) << endl;
+	}
+	else if (mode == "list" && argc > 3 && a < b)
+		list(a, b);
+	else if (mode == "mertens" && argc > 2)
+		mertens(a, b);
+	else if (mode == "check" && argc > 2 && a > 1)
+		return check(a) ? 0 : 1;
+	else {
+		cout << "usage: " << argv[0] << " sums lo hi" << endl;
+		cout << "       " << argv[0] << " list lo hi" << endl;
+		cout << "       " << argv[0] << " mertens x [points]" << endl;
+		cout << "       " << argv[0] << " check hi" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+/* multiplicative functions over a segment [lo, hi): Euler phi, Moebius mu, number
+   and sum of divisors - every prime power p^k <= hi with p <= sqrt(hi) steps over its
+   multiples and moves the values from p^(k-1) to p^k (no division for k = 1); what
+   the product of the powers misses is the one prime factor > sqrt(n). Memory is
+   that of one segment plus the base primes, whatever the range */
+
+#ifndef PR2_ARITH_H
+#define PR2_ARITH_H
+
+#include <vector>
+
+#include "sieve.h"
+
+const uLL arith_segment = 1 << 15;	// numbers per segment, 256 KB of products
+
+enum {
+	fn_phi = 1,
+	fn_mu = 2,
+	fn_sigma0 = 4,
+	fn_sigma1 = 8,
+	fn_all = 15
+};
+
+struct arith_segment_values {
+	uLL lo, hi;
+	unsigned which;			// fn_* flags, the other vectors stay empty
+	std::vector<uLL> prod;		// part of n factored so far
+	std::vector<uLL> phi;
+	std::vector<signed char> mu;
+	std::vector<uint32_t> sigma0;
+	std::vector<uLL> sigma1;
+
+	size_t size() const { return prod.size(); }
+
+	/* the sieve with the flags W fixed at compile time, no tests in the inner loops */
+	template <unsigned W> void run(const std::vector<unsigned> &base) {
+		const uLL l = lo, h = hi;
+		uLL *pr = prod.data(), *ph = phi.data(), *d1 = sigma1.data();
+		signed char *m = mu.data();
+		uint32_t *d0 = sigma0.data();
+		for (size_t k = 0; k < base.size(); ++k) {
+			uLL p = base[k];
+			if (p * p >= h)
+				break;
+			for (uLL j = (l + p - 1) / p * p; j < h; j += p) {
+				size_t i = j - l;
+				pr[i] *= p;
+				if (W & fn_phi)
+					ph[i] *= p - 1;
+				if (W & fn_mu)
+					m[i] = -m[i];
+				if (W & fn_sigma0)
+					d0[i] *= 2;
+				if (W & fn_sigma1)
+					d1[i] *= p + 1;
+			}
+			// p^e, e >= 2: sigma1 of p^(e-1) is s, of p^e is s + p^e
+			uLL s = 1 + p;
+			for (uLL e = 2, pe = p * p; pe < h; ++e) {
+				for (uLL j = (l + pe - 1) / pe * pe; j < h; j += pe) {
+					size_t i = j - l;
+					pr[i] *= p;
+					if (W & fn_phi)
+						ph[i] *= p;
+					if (W & fn_mu)
+						m[i] = 0;
+					if (W & fn_sigma0)
+						d0[i] = d0[i] / e * (e + 1);
+					if (W & fn_sigma1)
+						d1[i] = d1[i] / s * (s + pe);
+				}
+				s += pe;
+				if (pe > (h - 1) / p)
+					break;
+				pe *= p;
+			}
+		}
+		for (size_t i = 0; i < h - l; ++i) {
+			if (pr[i] == l + i)
+				continue;
+			uLL q = (W & (fn_phi | fn_sigma1)) ? (l + i) / pr[i] : 0;	// the prime > sqrt(n)
+			if (W & fn_phi)
+				ph[i] *= q - 1;
+			if (W & fn_mu)
+				m[i] = -m[i];
+			if (W & fn_sigma0)
+				d0[i] *= 2;
+			if (W & fn_sigma1)
+				d1[i] *= q + 1;
+		}
+	}
+
+	/* base - primes up to at least sqrt(hi - 1) (small_primes) */
+	void compute(uLL lo_, uLL hi_, const std::vector<unsigned> &base, unsigned which_ = fn_all) {
+		typedef void (arith_segment_values::*variant)(const std::vector<unsigned> &);
+		static const variant variants[16] = {
+			&arith_segment_values::run<0>, &arith_segment_values::run<1>,
+			&arith_segment_values::run<2>, &arith_segment_values::run<3>,
+			&arith_segment_values::run<4>, &arith_segment_values::run<5>,
+			&arith_segment_values::run<6>, &arith_segment_values::run<7>,
+			&arith_segment_values::run<8>, &arith_segment_values::run<9>,
+			&arith_segment_values::run<10>, &arith_segment_values::run<11>,
+			&arith_segment_values::run<12>, &arith_segment_values::run<13>,
+			&arith_segment_values::run<14>, &arith_segment_values::run<15>
+		};
+		lo = lo_ > 1 ? lo_ : 1;	// 0 is left out
+		hi = hi_ > lo ? hi_ : lo;
+		which = which_ & fn_all;
+		size_t n = hi - lo;
+		prod.assign(n, 1);
+		phi.assign(which & fn_phi ? n : 0, 1);
+		mu.assign(which & fn_mu ? n : 0, 1);
+		sigma0.assign(which & fn_sigma0 ? n : 0, 1);
+		sigma1.assign(which & fn_sigma1 ? n : 0, 1);
+		(this->*variants[which])(base);
+	}
+};
+
+#endif
@@ -0,0 +1,67 @@
+/* segmented sieve of Atkin (atkin.h) against the segmented sieve of Eratosthenes (sieve.h),
+   both counting the primes of [lo, hi) with the range split into chunks between threads
+
+   build: g++ -O2 -fopenmp atkin.cpp -o atkin
+   usage: ./atkin lo hi      one range
+          ./atkin            table of ranges up to 1e14 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <iostream>
+
+#include "sieve.h"
+#include "atkin.h"
+
+using namespace std;
+
+/* every thread takes whole chunks - a chunk keeps its sieve state between segments */
+
+template <class S> uLL parallel_count(uLL lo, uLL hi, double &t) {
+	uLL chunk = 64 * segment_numbers;
+	long long chunks = (long long) ((hi - lo + chunk - 1) / chunk);
+	uLL c = (lo <= 2 && hi > 2) ? 1 : 0;
+	double start = omp_get_wtime();
+	long long i;
+#pragma omp parallel for schedule(dynamic) reduction(+:c)
+	for (i = 0; i < chunks; ++i) {
+		uLL a = lo + i * chunk;
+		uLL b = hi - a > chunk ? a + chunk : hi;
+		S s(a, b);
+		while (s.next_segment())
+			c += s.count();
+	}
+	t = omp_get_wtime() - start;
+	return c;
+}
+
+bool compare(uLL lo, uLL hi) {
+	double te, ta;
+	uLL e = parallel_count<segment_sieve>(lo, hi, te);
+	uLL a = parallel_count<atkin_sieve>(lo, hi, ta);
+	printf("[%llu, %llu)  %llu primes  eratosthenes %.3f  atkin %.3f  (%.2fx)%s\n",
+		lo, hi, e, te, ta, ta / te, e == a ? "" : "  MISMATCH");
+	if (e != a)
+		printf("  atkin counted %llu\n", a);
+	return e == a;
+}
+
+int main(int argc, char **argv) {
+	cout << "threads: " << omp_get_max_threads() << endl;
+	bool ok = true;
+	if (argc > 2) {
+		uLL lo = strtoull(argv[1], NULL, 10), hi = strtoull(argv[2], NULL, 10);
+		if (hi > atkin_limit) {
+			cout << "hi above " << atkin_limit << " - the Atkin sieve keeps too many y's there" << endl;
+			return 1;
+		}
+		ok = compare(lo, hi);
+	}
+	else {
+		ok = compare(0, 100000000ULL) && ok;
+		ok = compare(0, 1000000000ULL) && ok;
+		ok = compare(1000000000000ULL, 1000000000000ULL + 1000000000ULL) && ok;
+		ok = compare(100000000000000ULL, 100000000000000ULL + 1000000000ULL) && ok;
+	}
+	return ok ? 0 : 1;
+}
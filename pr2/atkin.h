@@ -0,0 +1,175 @@
+/* segmented sieve of Atkin - generate_primes() (kopia (2).cpp) carried over to
+   64-bit ranges, one bit per odd number, same interface as segment_sieve:
+
+   n = 4x^2 + y^2, n % 12 in {1, 5}       x >= 1, y odd
+   n = 3x^2 + y^2, n % 12 == 7            x odd, y even
+   n = 3x^2 - y^2, n % 12 == 11           x > y >= 1, x + y odd
+   every solution toggles n; the square-free n with an odd count are the primes >= 5
+
+   the y of every x is kept between segments, so a segment costs its solutions plus
+   O(sqrt(high)) instead of a square root per x - the price is ~1.5 sqrt(stop) y's per
+   sieve (4 bytes each), so it is meant for stop <= atkin_limit; above that the
+   Eratosthenes sieve needs only the primes up to sqrt(stop) */
+
+#ifndef PR2_ATKIN_H
+#define PR2_ATKIN_H
+
+#include "sieve.h"
+
+const uLL atkin_limit = 1000000000000000ULL;	// 1e15 - 150 MB of y's
+
+struct atkin_sieve {
+	uLL start, stop;
+	uLL low, high;
+	uLL size;
+	std::vector<uint64_t> bits;
+	std::vector<unsigned> y1, y2, y3;	// next y per x of the three forms (y2 by x / 2)
+	uLL x3_min;			// forms 3 below it have no n >= low any more
+	std::vector<unsigned> primes;	// primes >= 5 for the squares
+	std::vector<uLL> next;		// next odd multiple of p^2
+	uLL base_limit;
+
+	atkin_sieve(uLL start_, uLL stop_, uLL size_ = segment_numbers)
+		: start(start_), stop(stop_), low(0), high(start_ & ~1ULL), size(size_), x3_min(1), base_limit(4) {
+		bits.resize(size / 128 + 1);
+		y1.push_back(0);	// x = 0 is not used
+		y3.push_back(0);
+	}
+
+	void toggle(uLL n) {
+		uLL k = (n - low) / 2;
+		bits[k / 64] ^= 1ULL << (k % 64);
+	}
+
+	/* smallest y >= from with y = parity (mod 2) and c + y^2 >= low */
+	uLL first_y(uLL c, uLL from, int parity) const {
+		uLL y = from;
+		if (c + y * y < low) {
+			y = isqrt(low - c);
+			if (y * y + c < low)
+				++y;
+		}
+		if ((int) (y & 1) != parity)
+			++y;
+		return y;
+	}
+
+	void forms() {
+		// 4x^2 + y^2
+		for (uLL x = 1; 4 * x * x + 1 < high; ++x) {
+			uLL c = 4 * x * x;
+			if (x == y1.size())
+				y1.push_back((unsigned) first_y(c, 1, 1));
+			uLL y = y1[x];
+			for (uLL n = c + y * y; n < high; y += 2, n = c + y * y) {
+				unsigned r = n % 12;
+				if (r == 1 || r == 5)
+					toggle(n);
+			}
+			y1[x] = (unsigned) y;
+		}
+		// 3x^2 + y^2, x odd
+		for (uLL x = 1; 3 * x * x + 4 < high; x += 2) {
+			uLL c = 3 * x * x;
+			uLL i = x / 2;
+			if (i == y2.size())
+				y2.push_back((unsigned) first_y(c, 2, 0));
+			uLL y = y2[i];
+			for (uLL n = c + y * y; n < high; y += 2, n = c + y * y)
+				if (n % 12 == 7)
+					toggle(n);
+			y2[i] = (unsigned) y;
+		}
+		// 3x^2 - y^2, y going down as n goes up
+		while (3 * x3_min * x3_min <= low)
+			++x3_min;
+		for (uLL x = x3_min; 2 * x * x + 2 * x - 1 < high; ++x) {
+			uLL c = 3 * x * x;
+			if (x >= y3.size()) {
+				y3.resize(x + 1);
+				uLL y = x - 1;	// largest y with c - y^2 >= low
+				if (c - y * y < low)
+					y = isqrt(c - low);
+				if ((y + x) % 2 == 0)
+					y = y ? y - 1 : 0;
+				y3[x] = (unsigned) y;
+			}
+			long long y = (long long) y3[x];
+			for (; y >= 1; y -= 2) {
+				uLL n = c - (uLL) (y * y);
+				if (n >= high)
+					break;
+				if (n % 12 == 11)
+					toggle(n);
+			}
+			y3[x] = y < 0 ? 0 : (unsigned) y;
+		}
+	}
+
+	void extend_base(uLL limit) {
+		uLL to = 2 * base_limit;
+		if (to < limit)
+			to = limit;
+		if (to > 0xffffffffULL)
+			to = 0xffffffffULL;
+		std::vector<unsigned> base = small_primes((unsigned) to);
+		for (size_t i = 2; i < base.size(); ++i) {
+			uLL p = base[i];
+			if (p <= base_limit)
+				continue;
+			uLL q = p * p;
+			uLL j = q;
+			if (j < low)
+				j = first_odd_multiple(low, q);
+			primes.push_back(base[i]);
+			next.push_back(j);
+		}
+		base_limit = to;
+	}
+
+	bool next_segment() {
+		if (high >= stop)
+			return false;
+		low = high;
+		high = stop - low > size ? low + size : stop;
+		memset(&bits[0], 0, bits.size() * sizeof(uint64_t));
+		forms();
+		if (base_limit < isqrt(high - 1))
+			extend_base(isqrt(high - 1));
+		for (size_t i = 0; i < primes.size(); ++i) {
+			uLL q = (uLL) primes[i] * primes[i];
+			if (q >= high)
+				break;
+			uLL j = next[i];
+			if (j >= high)
+				continue;
+			uLL k = (j - low) / 2, n = (high - low) / 2;
+			for (; k < n; k += q)
+				bits[k / 64] &= ~(1ULL << (k % 64));
+			next[i] = 2 * k + 1 > ~0ULL - low ? ~0ULL : low + 2 * k + 1;
+		}
+		if (low <= 3 && high > 3)
+			toggle(3);
+		for (uLL v = low + 1; v < start && v < high; v += 2) {
+			uLL k = (v - low) / 2;
+			bits[k / 64] &= ~(1ULL << (k % 64));
+		}
+		return true;
+	}
+
+	uLL count() const {
+		return popcount_words(&bits[0], bits.size());
+	}
+
+	template <class F> void each(F f) const {
+		for (size_t i = 0; i < bits.size(); ++i) {
+			uint64_t w = bits[i];
+			while (w) {
+				f(low + 2 * (i * 64 + __builtin_ctzll(w)) + 1);
+				w &= w - 1;
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,168 @@
+/* placement of the big sieve tables (hundreds of MB of flags / bits):
+
+   alloc_plain      - anonymous 4 KB pages, zeroed by one thread (what calloc + the
+                      first loop do today - every page lands on that thread's node)
+   alloc_first_touch- 4 KB pages, each thread zeroes the range it will sieve
+   alloc_thp        - 2 MB aligned, madvise(MADV_HUGEPAGE), first touch
+   alloc_hugetlb    - MAP_HUGETLB (reserved huge pages), first touch; falls back to
+                      alloc_thp when none are reserved
+   alloc_interleave - pages spread round robin over the NUMA nodes (mbind)
+
+   raw system calls only (as io_ring.h), so no -lnuma is needed; dtlb_counter reads
+   the dTLB load misses of the calling thread when perf events are allowed */
+
+#ifndef PR2_BIG_ALLOC_H
+#define PR2_BIG_ALLOC_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+
+enum alloc_policy {
+	alloc_plain,
+	alloc_first_touch,
+	alloc_thp,
+	alloc_hugetlb,
+	alloc_interleave
+};
+
+const char *const alloc_policy_names[] = { "plain", "first-touch", "thp", "hugetlb", "interleave" };
+const size_t huge_page = 2 << 20;
+
+struct big_buffer {
+	void *p;
+	size_t size;		// mapped bytes (rounded up to the page size)
+	alloc_policy policy;	// what was actually done (hugetlb may become thp)
+};
+
+/* NUMA nodes online, as a mask for mbind - from /sys, node 0 only when unknown */
+
+inline unsigned long numa_online_mask() {
+	unsigned long mask = 0;
+	FILE *f = fopen("/sys/devices/system/node/online", "r");
+	if (f) {
+		int a, b;
+		char sep;
+		while (fscanf(f, "%d", &a) == 1) {
+			b = a;
+			if (fscanf(f, "%c", &sep) == 1 && sep == '-' && fscanf(f, "%d", &b) == 1)
+				fscanf(f, "%c", &sep);
+			for (int i = a; i <= b && i < 64; ++i)
+				mask |= 1UL << i;
+			if (sep != ',')
+				break;
+		}
+		fclose(f);
+	}
+	return mask ? mask : 1;
+}
+
+/* zeroes [0, size) in chunk-sized pieces with the same static schedule as the sieve loop
+   of the caller, so each page is first touched by the thread that will use it */
+
+inline void first_touch(void *p, size_t size, size_t chunk) {
+	char *c = (char *) p;
+	long long pieces = (long long) ((size + chunk - 1) / chunk), i;
+#pragma omp parallel for schedule(static)
+	for (i = 0; i < pieces; ++i) {
+		size_t lo = i * chunk, len = size - lo < chunk ? size - lo : chunk;
+		memset(c + lo, 0, len);
+	}
+}
+
+/* size bytes of zeros; chunk - the piece of the table one loop iteration of the user
+   works on (first touch follows it); p == NULL when the mapping failed */
+
+inline big_buffer big_alloc(size_t size, alloc_policy policy, size_t chunk) {
+	big_buffer b;
+	b.policy = policy;
+	b.size = (size + huge_page - 1) / huge_page * huge_page;
+	b.p = NULL;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	if (policy == alloc_hugetlb) {
+		void *p = mmap(NULL, b.size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED)
+			b.p = p;
+		else
+			b.policy = alloc_thp;
+	}
+	if (!b.p) {
+		// 2 MB alignment: map one huge page more and cut the ends off
+		size_t over = b.size + huge_page;
+		void *p = mmap(NULL, over, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (p == MAP_FAILED)
+			return b;
+		uintptr_t a = ((uintptr_t) p + huge_page - 1) & ~(uintptr_t) (huge_page - 1);
+		if (a > (uintptr_t) p)
+			munmap(p, a - (uintptr_t) p);
+		if ((uintptr_t) p + over > a + b.size)
+			munmap((void *) (a + b.size), (uintptr_t) p + over - (a + b.size));
+		b.p = (void *) a;
+		// 4 KB pages unless asked for - THP is often "always" and would blur the comparison
+		madvise(b.p, b.size, b.policy == alloc_thp ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+		if (b.policy == alloc_interleave) {
+			unsigned long mask = numa_online_mask();
+			syscall(__NR_mbind, b.p, b.size, 3 /* MPOL_INTERLEAVE */, &mask, 64, 0);
+		}
+	}
+	if (b.policy == alloc_plain)
+		memset(b.p, 0, size);
+	else
+		first_touch(b.p, size, chunk);
+	return b;
+}
+
+inline void big_free(big_buffer &b) {
+	if (b.p)
+		munmap(b.p, b.size);
+	b.p = NULL;
+}
+
+/* dTLB load misses of the calling thread (user space) - ok() is false where perf
+   events are not allowed (containers, perf_event_paranoid) */
+
+struct dtlb_counter {
+	int fd;
+
+	dtlb_counter() {
+		struct perf_event_attr a;
+		memset(&a, 0, sizeof(a));
+		a.size = sizeof(a);
+		a.type = PERF_TYPE_HW_CACHE;
+		a.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		a.disabled = 1;
+		a.exclude_kernel = 1;
+		a.exclude_hv = 1;
+		fd = (int) syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+	}
+	~dtlb_counter() {
+		if (fd >= 0)
+			close(fd);
+	}
+
+	bool ok() const { return fd >= 0; }
+	void start() {
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+	uint64_t stop() {
+		uint64_t v = 0;
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd, &v, sizeof(v)) != sizeof(v))
+				v = 0;
+		}
+		return v;
+	}
+};
+
+#endif
@@ -0,0 +1,61 @@
+/* prime constellations and Goldbach verification (constellation.h)
+
+   build: g++ -O2 -fopenmp constellation.cpp -o constellation
+   usage: ./constellation count lo hi pattern    tuples inside [lo, hi]
+          ./constellation list lo hi pattern     one tuple per line, in order
+          ./constellation goldbach lo hi         every even n in [lo, hi] is p + q
+   pattern: twin, cousin, sexy, triplet, triplet2, quadruplet, quintuplet,
+            quintuplet2, sextuplet or offsets like 0,2,6,8                     */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+#include <iostream>
+
+#include "constellation.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+	string mode = argc > 1 ? argv[1] : "";
+	uLL lo = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+	uLL hi = argc > 3 ? strtoull(argv[3], NULL, 10) : 0;
+	prime_pattern t;
+	if ((mode == "count" || mode == "list") && argc > 4) {
+		if (!t.parse(argv[4])) {
+			cerr << "bad pattern " << argv[4] << endl;
+			return 1;
+		}
+		if (!t.admissible())
+			cerr << "pattern is not admissible - only small matches can exist" << endl;
+		double start = omp_get_wtime();
+		uLL n;
+		if (mode == "count")
+			n = count_tuples(lo, hi, t);
+		else
+			n = find_tuples(lo, hi, t, [&](uLL p) {
+				for (size_t j = 0; j < t.offsets.size(); ++j)
+					printf(j + 1 < t.offsets.size() ? "%llu " : "%llu\n", p + t.offsets[j]);
+			});
+		fflush(stdout);
+		cerr << n << " tuples in [" << lo << ", " << hi << "]: " << omp_get_wtime() - start << endl;
+		return 0;
+	}
+	if (mode == "goldbach" && argc > 3) {
+		double start = omp_get_wtime();
+		goldbach_result r = goldbach(lo, hi);
+		cout << r.checked << " even numbers checked: " << omp_get_wtime() - start << endl;
+		if (r.max_p)
+			cout << "largest smallest p: " << r.max_p << " (n = " << r.max_n << ")" << endl;
+		if (r.failed) {
+			cout << "NOT a sum of two primes: " << r.failed << endl;
+			return 1;
+		}
+		return 0;
+	}
+	cout << "usage: " << argv[0] << " count lo hi pattern" << endl;
+	cout << "       " << argv[0] << " list lo hi pattern" << endl;
+	cout << "       " << argv[0] << " goldbach lo hi" << endl;
+	return 1;
+}
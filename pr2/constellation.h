@@ -0,0 +1,242 @@
+/* prime constellations and Goldbach's conjecture on the bits of the segmented sieve
+
+   a k-tuple pattern {0, d1, .., dk} (even d) matches at p when p + d1, .., p + dk are
+   primes too: the bitmap shifted by d/2 bits is ANDed in, 64 starting points at a
+   time. Goldbach: even n = A + 2t are bit t of a word, the bitmap shifted to n - p
+   clears the n that p covers, small primes p are tried until the word is empty */
+
+#ifndef PR2_CONSTELLATION_H
+#define PR2_CONSTELLATION_H
+
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+
+#include "sieve.h"
+#include "miller_rabin.h"
+
+const uLL constellation_chunk = 1 << 24;	// numbers per thread task, 1 MB of bits
+const unsigned goldbach_primes = 1 << 16;	// small primes tried by the bit-parallel pass
+
+/* odd primes of [a, b) as one bitmap, bit i <-> a + 2i + 1 (a even) */
+
+struct prime_bitmap {
+	uLL a, b;
+	std::vector<uint64_t> bits;
+
+	void sieve(uLL a_, uLL b_) {
+		a = a_ & ~1ULL;
+		b = b_;
+		bits.assign((b - a) / 128 + 2, 0);	// + 1 word of zeros for word_at()
+		segment_sieve s(a, b);
+		while (s.next_segment()) {
+			size_t first = (s.low - a) / 128;	// segments are whole words
+			size_t words = ((s.high - s.low) / 2 + 63) / 64;
+			memcpy(&bits[first], &s.bits[0], words * sizeof(uint64_t));
+		}
+	}
+
+	/* 64 bits from bit pos on, zeros outside the bitmap (pos may be negative) */
+	uint64_t word_at(long long pos) const {
+		if (pos < 0) {
+			if (pos <= -64)
+				return 0;
+			return bits[0] << -pos;
+		}
+		size_t w = (size_t) pos / 64;
+		unsigned s = (unsigned) pos % 64;
+		if (w + 1 >= bits.size())
+			return w < bits.size() ? bits[w] >> s : 0;
+		return s ? (bits[w] >> s) | (bits[w + 1] << (64 - s)) : bits[w];
+	}
+};
+
+/* offsets of a k-tuple, first one 0 */
+
+struct prime_pattern {
+	std::vector<unsigned> offsets;
+
+	unsigned width() const { return offsets.back(); }
+
+	/* names or a list "0,2,6,8" */
+	bool parse(const std::string &s) {
+		static const char *names[][2] = {
+			{"twin", "0,2"}, {"cousin", "0,4"}, {"sexy", "0,6"},
+			{"triplet", "0,2,6"}, {"triplet2", "0,4,6"},
+			{"quadruplet", "0,2,6,8"},
+			{"quintuplet", "0,2,6,8,12"}, {"quintuplet2", "0,4,6,10,12"},
+			{"sextuplet", "0,4,6,10,12,16"}
+		};
+		std::string list = s;
+		for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+			if (s == names[i][0])
+				list = names[i][1];
+		offsets.clear();
+		const char *p = list.c_str();
+		while (*p) {
+			char *end;
+			unsigned long d = strtoul(p, &end, 10);
+			if (end == p)
+				return false;
+			offsets.push_back((unsigned) d);
+			p = *end == ',' ? end + 1 : end;
+			if (*end && *end != ',')
+				return false;
+		}
+		if (offsets.empty() || offsets[0] != 0)
+			return false;
+		for (size_t i = 1; i < offsets.size(); ++i)
+			if (offsets[i] <= offsets[i - 1] || offsets[i] % 2)
+				return false;
+		return true;
+	}
+
+	/* no prime q <= k has all residues covered - else only finitely many matches */
+	bool admissible() const {
+		std::vector<unsigned> q = small_primes((unsigned) offsets.size());
+		for (size_t i = 0; i < q.size(); ++i) {
+			std::vector<char> hit(q[i], 0);
+			unsigned covered = 0;
+			for (size_t j = 0; j < offsets.size(); ++j)
+				if (!hit[offsets[j] % q[i]]) {
+					hit[offsets[j] % q[i]] = 1;
+					++covered;
+				}
+			if (covered == q[i])
+				return false;
+		}
+		return true;
+	}
+};
+
+/* odd starting primes p of the pattern with the whole tuple in [lo, hi]; f(p) is called in
+   increasing order from the calling thread, chunks are sieved in parallel in batches
+   of a few per thread, so the output streams. Returns the number of matches */
+
+template <class F> uLL find_tuples(uLL lo, uLL hi, const prime_pattern &t, F f, bool list = true) {
+	if (hi < t.width() || hi - t.width() < lo)
+		return 0;
+	uLL first = lo & ~1ULL, last = hi - t.width() + 1;	// starts in [lo, last)
+	uLL chunks = (last - first + constellation_chunk - 1) / constellation_chunk;
+	int threads = omp_get_max_threads();
+	long long batch = list ? 4 * threads : (long long) chunks;
+	std::vector<std::vector<uLL> > found(list ? batch : 0);
+	uLL total = 0;
+	for (uLL c0 = 0; c0 < chunks; c0 += batch) {
+		long long n = chunks - c0 < (uLL) batch ? (long long) (chunks - c0) : batch;
+		long long k;
+#pragma omp parallel for schedule(dynamic) reduction(+:total)
+		for (k = 0; k < n; ++k) {
+			uLL a = first + (c0 + k) * constellation_chunk;
+			uLL e = last - a > constellation_chunk ? a + constellation_chunk : last;
+			uLL s = a > lo ? a : lo;
+			prime_bitmap m;
+			m.sieve(a, e + t.width() + 1);
+			uLL i0 = (s - a) / 2, i1 = (e - a) / 2;	// bits of the odd starts in [s, e)
+			if (list)
+				found[k].clear();
+			for (uLL w = i0 / 64; w * 64 < i1; ++w) {
+				uint64_t x = m.bits[w];
+				for (size_t j = 1; j < t.offsets.size() && x; ++j)
+					x &= m.word_at((long long) (w * 64 + t.offsets[j] / 2));
+				if (w == i0 / 64 && i0 % 64)
+					x &= ~0ULL << (i0 % 64);
+				if ((w + 1) * 64 > i1 && i1 % 64)
+					x &= (1ULL << (i1 % 64)) - 1;
+				total += __builtin_popcountll(x);
+				if (list)
+					for (; x; x &= x - 1)
+						found[k].push_back(a + 2 * (w * 64 + __builtin_ctzll(x)) + 1);
+			}
+		}
+		if (list)
+			for (long long j = 0; j < n; ++j)
+				for (size_t i = 0; i < found[j].size(); ++i)
+					f(found[j][i]);
+	}
+	return total;
+}
+
+inline uLL count_tuples(uLL lo, uLL hi, const prime_pattern &t) {
+	return find_tuples(lo, hi, t, [](uLL) {}, false);
+}
+
+struct goldbach_result {
+	uLL checked;		// even n verified
+	uLL max_p, max_n;	// largest "smallest p with n - p prime" and its n
+	uLL failed;		// first n without p + q, 0 if none
+};
+
+/* every even n in [lo, hi] (n >= 4) is checked to be p + q */
+
+inline goldbach_result goldbach(uLL lo, uLL hi) {
+	goldbach_result r = {0, 0, 0, 0};
+	if (lo < 4)
+		lo = 4;
+	lo = (lo + 1) & ~1ULL;
+	if (hi < lo)
+		return r;
+	std::vector<unsigned> small = small_primes(goldbach_primes);	// small[0] = 2
+	uLL P = goldbach_primes;
+	uLL chunks = (hi - lo) / constellation_chunk + 1;
+	long long k;
+#pragma omp parallel for schedule(dynamic)
+	for (k = 0; k < (long long) chunks; ++k) {
+		uLL A = lo + k * constellation_chunk;
+		uLL B = hi + 1 - A > constellation_chunk ? A + constellation_chunk : hi + 1;	// n in [A, B)
+		uLL a = A > P ? A - P : 0;
+		prime_bitmap m;
+		m.sieve(a, B);
+		uLL words = ((B - A + 1) / 2 + 63) / 64;
+		uLL max_p = 0, max_n = 0, failed = 0, checked = 0;
+		for (uLL w = 0; w < words; ++w) {
+			uLL count = (B - A + 1) / 2 - w * 64;	// even n left from this word on
+			uint64_t left = count >= 64 ? ~0ULL : (1ULL << count) - 1;
+			checked += __builtin_popcountll(left);
+			if (A + 128 * w == 4)
+				left &= ~1ULL;	// 4 = 2 + 2
+			for (size_t i = 1; i < small.size() && left; ++i) {
+				uLL p = small[i];
+				// n - p = A + 2(64w + t) - p <-> bit (A - p - a - 1) / 2 + 64w + t
+				long long pos = ((long long) (A - a) - (long long) p - 1) / 2 + (long long) (64 * w);
+				uint64_t hit = left & m.word_at(pos);
+				if (hit) {
+					if (p > max_p) {
+						max_p = p;
+						max_n = A + 2 * (64 * w + __builtin_ctzll(hit));
+					}
+					left &= ~hit;
+				}
+			}
+			// beyond the small primes: Miller-Rabin for n - q, q prime (never seen so far)
+			for (; left; left &= left - 1) {
+				uLL n = A + 2 * (64 * w + __builtin_ctzll(left));
+				uLL q = P + 1;
+				while (q <= n / 2 && !(is_prime_mr(q) && is_prime_mr(n - q)))
+					q += 2;
+				if (q > n / 2) {
+					if (!failed)
+						failed = n;
+				}
+				else if (q > max_p) {
+					max_p = q;
+					max_n = n;
+				}
+			}
+		}
+#pragma omp critical
+		{
+			r.checked += checked;
+			if (max_p > r.max_p || (max_p == r.max_p && max_n < r.max_n)) {
+				r.max_p = max_p;
+				r.max_n = max_n;
+			}
+			if (failed && (!r.failed || failed < r.failed))
+				r.failed = failed;
+		}
+	}
+	return r;
+}
+
+#endif
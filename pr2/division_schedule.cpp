@@ -0,0 +1,149 @@
+/* schedules of the trial division (methods.h) and the wait at the final barrier: every
+   schedule runs the same divide() over [0, n], each thread notes when it ran out of
+   work - tail is the last thread done minus the first one idle; then the model alone, on
+   one thread: the slowest / fastest of 32 chunks of equal size and of 32 chunks of equal
+   predicted work (with the fit of the scheduled run) - on a machine with fewer cores
+   than threads the tails mostly show the time slices, this does not
+
+   even      - one equal range per thread (schedule(static))
+   blocked   - 16 equal chunks per thread, dynamic (division_blocked)
+   dynamic   - chunks of 1024 numbers (division_parallel)
+   scheduled - chunks of equal predicted work, refitted as they finish (division_schedule.h)
+
+   build: g++ -O2 -fopenmp division_schedule.cpp -o division_schedule
+   usage: ./division_schedule [n [threads [repeats]]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <iostream>
+
+#include "methods.h"
+
+using namespace std;
+
+/* chunks of size numbers taken in order from an atomic counter (static: one per thread) */
+
+schedule_stats run_equal(uLL n, bool *prime, int threads, uLL size, bool fixed) {
+	schedule_stats st;
+	st.busy.assign(threads, 0);
+	st.a = st.b = 0;
+	vector<double> finish(threads, -1);	// -1: the thread did not run
+	atomic<uLL> next(0);
+	uLL chunks = (n + size) / size;
+	double start = omp_get_wtime();
+#pragma omp parallel num_threads(threads)
+	{
+		int t = omp_get_thread_num();
+		for (uLL c = fixed ? t : next++; c < chunks; c = fixed ? chunks : next++) {
+			double s = omp_get_wtime();
+			uLL to = (c + 1) * size < n + 1 ? (c + 1) * size : n + 1;
+			for (uLL i = c * size; i < to; ++i)
+				prime[i] = divide(i);
+			st.busy[t] += omp_get_wtime() - s;
+		}
+		finish[t] = omp_get_wtime();
+	}
+	double first = 0, last = 0;
+	bool any = false;
+	for (int t = 0; t < threads; ++t) {
+		if (finish[t] < 0)
+			continue;
+		first = !any || finish[t] < first ? finish[t] : first;
+		last = !any || finish[t] > last ? finish[t] : last;
+		any = true;
+	}
+	st.chunks = chunks;
+	st.wall = last - start;
+	st.tail = last - first;
+	return st;
+}
+
+schedule_stats run_scheduled(uLL n, bool *prime, int threads) {
+	division_scheduler s(0, n + 1, threads);
+	return s.run([&](uLL from, uLL to) {
+		for (uLL i = from; i < to; ++i)
+			prime[i] = divide(i);
+	});
+}
+
+/* slowest / fastest chunk [cuts[k + 1], cuts[k]) */
+
+double spread(const vector<uLL> &cuts, bool *prime) {
+	double lo = 0, hi = 0;
+	for (size_t k = 0; k + 1 < cuts.size(); ++k) {
+		double s = omp_get_wtime();
+		for (uLL i = cuts[k + 1]; i < cuts[k]; ++i)
+			prime[i] = divide(i);
+		double t = omp_get_wtime() - s;
+		lo = k == 0 || t < lo ? t : lo;
+		hi = t > hi ? t : hi;
+	}
+	return hi / lo;
+}
+
+int main(int argc, char **argv) {
+	uLL n = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000000;
+	int threads = argc > 2 ? atoi(argv[2]) : omp_get_max_threads();
+	int repeats = argc > 3 ? atoi(argv[3]) : 3;
+	if (n > division_limit || threads < 1) {
+		cout << "usage: " << argv[0] << " [n [threads [repeats]]]    n <= " << division_limit << endl;
+		return 1;
+	}
+	bool *prime = new bool[n + 1];
+	bool *check = new bool[n + 1];
+	sieve_segmented(n, check);
+
+	const char *names[] = { "even", "blocked", "dynamic", "scheduled" };
+	int wrong = 0;
+	double a = 0, b = 0;
+	cout << "n = " << n << ", " << threads << " threads, best of " << repeats << endl;
+	for (int k = 0; k < 4; ++k) {
+		schedule_stats best = schedule_stats();
+		for (int r = 0; r < repeats; ++r) {
+			schedule_stats st = k == 0 ? run_equal(n, prime, threads, (n + threads) / threads, true)
+					  : k == 1 ? run_equal(n, prime, threads, (n + 16 * threads) / (16 * threads), false)
+					  : k == 2 ? run_equal(n, prime, threads, 1024, false)
+					  : run_scheduled(n, prime, threads);
+			if (r == 0 || st.wall < best.wall)
+				best = st;
+		}
+		if (memcmp(prime, check, n + 1)) {
+			cout << names[k] << " differs from the sieve" << endl;
+			++wrong;
+		}
+		double lo = best.busy[0], hi = best.busy[0];
+		for (int t = 1; t < threads; ++t) {
+			lo = best.busy[t] < lo ? best.busy[t] : lo;
+			hi = best.busy[t] > hi ? best.busy[t] : hi;
+		}
+		printf("%-10s wall %.4f s, tail %.4f s (%.1f%%), busy %.4f .. %.4f s, %llu chunks", names[k], best.wall,
+		       best.tail, 100 * best.tail / best.wall, lo, hi, best.chunks);
+		if (k == 3) {
+			printf(", fit %.3g ns + %.3g ns sqrt(x) / ln^2 x per number", best.a * 1e9, best.b * 1e9);
+			a = best.a;
+			b = best.b;
+		}
+		printf("\n");
+	}
+
+	const int parts = 32;
+	division_scheduler model(0, n + 1, 1);
+	model.a = a;
+	model.b = b;
+	vector<uLL> equal(parts + 1), balanced(parts + 1);
+	double w = model.work(0, (double) (n + 1)) / parts;
+	for (int k = 0; k <= parts; ++k) {
+		equal[k] = (n + 1) / parts * (parts - k);
+		balanced[k] = k == 0 ? n + 1 : k == parts ? 0 : model.cut(balanced[k - 1], w);
+	}
+	equal[0] = n + 1;
+	printf("one thread, %d chunks: equal size x%.2f, equal predicted work x%.2f (slowest / fastest)\n",
+	       parts, spread(equal, prime), spread(balanced, prime));
+	delete[] prime;
+	delete[] check;
+	return wrong ? 1 : 0;
+}
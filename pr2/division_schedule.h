@@ -0,0 +1,203 @@
+/* trial division over [lo, hi) in chunks of equal predicted work
+
+   testing i costs the primes up to its smallest factor: a few for most numbers,
+   pi(sqrt(i)) for the 1 / ln i of them that are primes, and about as much for the
+   products of two large primes - per number roughly a + b sqrt(i) / ln^2 i divisions.
+   The work grows along the range, so equal chunks (division_blocked) or a fixed grain
+   (division_parallel) end with the heaviest chunks, and the threads that finished
+   early wait at the barrier for them
+
+   division_scheduler cuts the chunks from the top of the range down (heaviest first),
+   each remaining / (2 threads) of the predicted work - guided by work, not by count -
+   but never below total / (division_grain threads), so the last chunks are small.
+   The model is a x + b C(x), C the integral of sqrt(x) / ln^2 x tabulated at knots;
+   every finished chunk adds its time to a least squares fit of a and b (relative
+   error), and the chunks still to be cut follow the fit. The time of a chunk is the
+   CPU time of its thread, so the fit does not see the time slices when the threads
+   share cores with each other or with other jobs */
+
+#ifndef PR2_DIVISION_SCHEDULE_H
+#define PR2_DIVISION_SCHEDULE_H
+
+#include <math.h>
+#include <time.h>
+#include <omp.h>
+#include <vector>
+#include <mutex>
+
+typedef unsigned long long uLL;
+
+const unsigned division_knots = 1024;
+const unsigned division_grain = 64;	// smallest chunk: total work / (grain * threads)
+const uLL division_align = 64;		// chunk ends, so two threads never share a cache line of flags
+
+inline double thread_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* the growing part of the cost per number */
+
+inline double division_density(double x) {
+	if (x < 16)
+		return 0;
+	double l = log(x);
+	return sqrt(x) / (l * l);
+}
+
+struct schedule_stats {
+	uLL chunks;
+	double wall;			// first chunk taken .. last chunk done
+	double tail;			// last thread done - first thread out of work
+	double a, b;			// the final fit, seconds per number / per unit of C
+	std::vector<double> busy;	// per thread
+};
+
+struct division_scheduler {
+	uLL lo, hi;
+	int threads;
+	std::vector<double> x, c;	// knots and C at the knots
+	double a, b;			// seconds (prior: divisions) per number and per unit of C
+	uLL top;			// [lo, top) is not handed out yet
+	double s00, s01, s11, s0t, s1t;	// normal equations, rows weighted by 1 / t
+	double scale_pred, scale_time;	// sum of the predictions of the prior, of the times
+	uLL measured;
+	std::mutex m;
+
+	division_scheduler(uLL lo_, uLL hi_, int threads_)
+		: lo(lo_), hi(hi_), threads(threads_), a(2), b(2), top(hi_),
+		  s00(0), s01(0), s11(0), s0t(0), s1t(0), scale_pred(0), scale_time(0), measured(0) {
+		x.resize(division_knots + 1);
+		c.resize(division_knots + 1);
+		double step = (double) (hi - lo) / division_knots;
+		c[0] = 0;
+		for (unsigned k = 0; k <= division_knots; ++k) {
+			x[k] = lo + k * step;
+			if (k)	// Simpson over the knot interval
+				c[k] = c[k - 1] + step / 6 * (division_density(x[k - 1]) + 4 * division_density(x[k] - step / 2)
+							      + division_density(x[k]));
+		}
+	}
+
+	/* C(v), linear between the knots */
+	double cost_at(double v) const {
+		if (v <= x[0])
+			return 0;
+		if (v >= x[division_knots])
+			return c[division_knots];
+		double step = x[1] - x[0];
+		unsigned k = (unsigned) ((v - x[0]) / step);
+		if (k >= division_knots)
+			k = division_knots - 1;
+		return c[k] + (c[k + 1] - c[k]) * (v - x[k]) / step;
+	}
+
+	double work(double u, double v) const {
+		return a * (v - u) + b * (cost_at(v) - cost_at(u));
+	}
+
+	/* the v in [lo, t] with work(v, t) = w, by bisection (work is monotone in v) */
+	uLL cut(uLL t, double w) const {
+		uLL l = lo, r = t;
+		while (r - l > 1) {
+			uLL mid = l + (r - l) / 2;
+			if (work((double) mid, (double) t) > w)
+				l = mid;
+			else
+				r = mid;
+		}
+		return l;
+	}
+
+	/* the next chunk [from, to), false when everything is handed out */
+	bool take(uLL &from, uLL &to) {
+		std::lock_guard<std::mutex> l(m);
+		if (top <= lo)
+			return false;
+		double w = work((double) lo, (double) top) / (2 * threads);
+		double least = work((double) lo, (double) hi) / ((double) division_grain * threads);
+		if (w < least)
+			w = least;
+		uLL v = cut(top, w) / division_align * division_align;
+		if (v + division_align > top)	// at least a cache line
+			v = (top - 1) / division_align * division_align;
+		if (v < lo)
+			v = lo;
+		from = v;
+		to = top;
+		top = v;
+		return true;
+	}
+
+	/* a chunk took seconds - refit a and b */
+	void done(uLL from, uLL to, double seconds) {
+		if (seconds <= 0)
+			return;
+		std::lock_guard<std::mutex> l(m);
+		double d0 = (double) (to - from), d1 = cost_at((double) to) - cost_at((double) from);
+		scale_pred += 2 * d0 + 2 * d1;
+		scale_time += seconds;
+		double w = 1 / (seconds * seconds);
+		s00 += w * d0 * d0;
+		s01 += w * d0 * d1;
+		s11 += w * d1 * d1;
+		s0t += w * d0 * seconds;
+		s1t += w * d1 * seconds;
+		++measured;
+		double det = s00 * s11 - s01 * s01;
+		double fa = 0, fb = 0;
+		if (measured >= 2 && det > 1e-9 * s00 * s11) {
+			fa = (s0t * s11 - s1t * s01) / det;
+			fb = (s1t * s00 - s0t * s01) / det;
+		}
+		if (fa > 0 && fb >= 0) {
+			a = fa;
+			b = fb;
+		}
+		else {		// one chunk, or a fit that makes no sense - the prior, rescaled
+			a = 2 * scale_time / scale_pred;
+			b = a;
+		}
+	}
+
+	/* f(from, to) over every chunk on the current OpenMP threads; the tail is taken over
+	   the threads that ran (the runtime may start fewer) */
+	template <class F> schedule_stats run(F f) {
+		schedule_stats st;
+		st.busy.assign(threads, 0);
+		std::vector<double> finish(threads, -1);
+		uLL chunks = 0;
+		double start = omp_get_wtime();
+#pragma omp parallel num_threads(threads) reduction(+ : chunks)
+		{
+			int t = omp_get_thread_num();
+			uLL from, to;
+			while (take(from, to)) {
+				double s = omp_get_wtime(), cpu = thread_seconds();
+				f(from, to);
+				done(from, to, thread_seconds() - cpu);
+				st.busy[t] += omp_get_wtime() - s;
+				++chunks;
+			}
+			finish[t] = omp_get_wtime();
+		}
+		double first = 0, last = 0;
+		bool any = false;
+		for (int t = 0; t < threads; ++t) {
+			if (finish[t] < 0)
+				continue;
+			first = !any || finish[t] < first ? finish[t] : first;
+			last = !any || finish[t] > last ? finish[t] : last;
+			any = true;
+		}
+		st.chunks = chunks;
+		st.wall = last - start;
+		st.tail = last - first;
+		st.a = a;
+		st.b = b;
+		return st;
+	}
+};
+
+#endif
@@ -0,0 +1,110 @@
+/* factorization of 64- and 128-bit numbers (factor.h)
+
+   build: g++ -O2 -fopenmp factor.cpp -o factor
+   usage: ./factor n ...                 prime factors of each n < 2^128
+          ./factor batch count bits      count random products of two bits/2-bit primes,
+                                         factored in parallel and checked          */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+
+#include "factor.h"
+
+using namespace std;
+
+string to_string(u128 v) {
+	string s;
+	do {
+		s.insert(s.begin(), (char) ('0' + (int) (v % 10)));
+		v /= 10;
+	} while (v);
+	return s;
+}
+
+bool parse(const char *s, u128 &v) {
+	v = 0;
+	if (!*s)
+		return false;
+	for (; *s; ++s) {
+		if (*s < '0' || *s > '9')
+			return false;
+		u128 t = v * 10 + (*s - '0');
+		if (t / 10 != v)
+			return false;	// does not fit
+		v = t;
+	}
+	return true;
+}
+
+/* random prime of the given bits */
+
+u128 random_prime(mt19937_64 &rng, unsigned bits) {
+	for (;;) {
+		u128 r = ((u128) rng() << 64 | rng());
+		r = (r >> (128 - bits)) | ((u128) 1 << (bits - 1)) | 1;
+		if (is_prime128(r))
+			return r;
+	}
+}
+
+bool batch(size_t count, unsigned bits) {
+	mt19937_64 rng(bits);
+	vector<u128> n(count);
+	for (size_t i = 0; i < count; ++i)
+		n[i] = random_prime(rng, bits / 2) * random_prime(rng, bits - bits / 2);
+	vector<u128> f;
+	vector<size_t> offsets;
+	double start = omp_get_wtime();
+	factor_batch(&n[0], count, f, offsets);
+	double stop = omp_get_wtime();
+	size_t errors = 0;
+	for (size_t i = 0; i < count; ++i) {
+		u128 p = 1;
+		for (size_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+			p *= f[j];
+			if (!is_prime128(f[j]))
+				++errors;
+		}
+		if (p != n[i])
+			++errors;
+	}
+	cout << count << " semiprimes of " << bits << " bits: " << stop - start << " ("
+	     << (stop - start) / count * 1e3 << " ms each), " << errors << " errors" << endl;
+	return errors == 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		cout << "usage: " << argv[0] << " n ..." << endl;
+		cout << "       " << argv[0] << " batch count bits" << endl;
+		return 1;
+	}
+	if (string(argv[1]) == "batch" && argc > 3) {
+		unsigned bits = atoi(argv[3]);
+		if (bits < 8 || bits > 127) {
+			cout << "bits in [8, 127]" << endl;
+			return 1;
+		}
+		return batch(strtoull(argv[2], NULL, 10), bits) ? 0 : 1;
+	}
+	for (int i = 1; i < argc; ++i) {
+		u128 n;
+		if (!parse(argv[i], n)) {
+			cout << argv[i] << ": not a number below 2^128" << endl;
+			continue;
+		}
+		double start = omp_get_wtime();
+		vector<u128> f = factor128(n);
+		double stop = omp_get_wtime();
+		cout << argv[i] << ":";
+		for (size_t j = 0; j < f.size(); ++j)
+			cout << " " << to_string(f[j]);
+		cout << "  (" << stop - start << " s)" << endl;
+	}
+	return 0;
+}
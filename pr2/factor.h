@@ -0,0 +1,456 @@
+/* factorization of 64- and 128-bit numbers: small primes, Pollard-Brent (products of
+   128 differences per gcd), ECM on Montgomery curves for the 128-bit ones where rho
+   would need ~sqrt(p) steps; Miller-Rabin decides when to stop, all arithmetic in
+   Montgomery form (montgomery64 from miller_rabin.h, montgomery128 here)
+
+   128-bit primality: bases 2..41 are deterministic below 3.3 * 10^24 (Sorenson and
+   Webster), above it the 20 bases 2..71 make a probable prime */
+
+#ifndef PR2_FACTOR_H
+#define PR2_FACTOR_H
+
+#include <stdint.h>
+#include <omp.h>
+#include <vector>
+#include <algorithm>
+
+#include "sieve.h"
+#include "miller_rabin.h"
+
+/* 128 x 128 -> 256 bit product */
+
+inline void mul256(u128 a, u128 b, u128 &hi, u128 &lo) {
+	uint64_t a0 = (uint64_t) a, a1 = (uint64_t) (a >> 64), b0 = (uint64_t) b, b1 = (uint64_t) (b >> 64);
+	u128 p00 = (u128) a0 * b0, p01 = (u128) a0 * b1, p10 = (u128) a1 * b0, p11 = (u128) a1 * b1;
+	u128 mid = (p00 >> 64) + (uint64_t) p01 + (uint64_t) p10;
+	lo = (u128) (uint64_t) p00 | (mid << 64);
+	hi = p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+}
+
+/* arithmetic mod odd n in Montgomery form, R = 2^128 */
+
+struct montgomery128 {
+	u128 n, inv, one, r2;
+
+	montgomery128(u128 n_) : n(n_) {
+		inv = n;	// n^-1 mod 2^128, Newton from 3 correct bits
+		for (int i = 0; i < 6; ++i)
+			inv *= 2 - n * inv;
+		one = (0 - n) % n;
+		r2 = one;
+		for (int i = 0; i < 128; ++i)
+			r2 = r2 >= n - r2 ? r2 - (n - r2) : r2 + r2;
+	}
+
+	u128 mul(u128 a, u128 b) const {
+		u128 hi, lo, mhi, mlo;
+		mul256(a, b, hi, lo);
+		mul256(lo * inv, n, mhi, mlo);
+		return hi >= mhi ? hi - mhi : hi - mhi + n;
+	}
+
+	u128 to(u128 a) const { return mul(a % n, r2); }
+	u128 from(u128 a) const { return mul(a, 1); }
+
+	u128 pow(u128 a, u128 e) const {
+		u128 r = one;
+		for (; e; e >>= 1) {
+			if (e & 1)
+				r = mul(r, a);
+			a = mul(a, a);
+		}
+		return r;
+	}
+};
+
+template <class T> inline T mod_add(T a, T b, T n) { return a >= n - b ? a - (n - b) : a + b; }
+template <class T> inline T mod_sub(T a, T b, T n) { return a >= b ? a - b : a + (n - b); }
+
+inline int ctz128(u128 a) {
+	uint64_t lo = (uint64_t) a;
+	return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll((uint64_t) (a >> 64));
+}
+
+/* binary gcd */
+
+template <class T> inline T gcd(T a, T b) {
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	int s = ctz128(a | b);
+	a >>= ctz128(a);
+	while (b) {
+		b >>= ctz128(b);
+		if (a > b) {
+			T t = a;
+			a = b;
+			b = t;
+		}
+		b -= a;
+	}
+	return a << s;
+}
+
+inline bool is_prime128(u128 n) {
+	if (n >> 64 == 0)
+		return is_prime_mr((uint64_t) n);
+	if (!(n & 1))
+		return false;
+	static const uint32_t bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41,
+		43, 47, 53, 59, 61, 67, 71 };
+	for (size_t i = 1; i < sizeof(bases) / sizeof(bases[0]); ++i)
+		if (n % bases[i] == 0)
+			return false;
+	bool proven = n < (u128) 3317044064679887385ULL * 1000000 + 961981;	// 3317044064679887385961981
+	size_t rounds = proven ? 13 : 20;
+	montgomery128 m(n);
+	int s = ctz128(n - 1);
+	u128 d = (n - 1) >> s, minus_one = n - m.one;
+	for (size_t i = 0; i < rounds; ++i) {
+		u128 x = m.pow(m.to(bases[i]), d);
+		if (x == m.one || x == minus_one)
+			continue;
+		int r = 1;
+		for (; r < s; ++r) {
+			x = m.mul(x, x);
+			if (x == minus_one)
+				break;
+		}
+		if (r == s)
+			return false;
+	}
+	return true;
+}
+
+/* Pollard-Brent with f(x) = x^2 + c; a divisor of n (maybe n itself), 0 when the
+   cycle is not closed after max_steps */
+
+template <class M, class T> T pollard_brent(const M &m, T c, T x0, uLL max_steps) {
+	const uLL block = 128;	// differences per gcd
+	T n = m.n, y = x0, x = x0, ys = x0, q = m.one, g = 1;
+	c = m.to(c);
+	uLL r = 1, steps = 0;
+	auto f = [&](T v) { return mod_add(m.mul(v, v), c, n); };
+	while (g == 1) {
+		x = y;
+		for (uLL i = 0; i < r; ++i)
+			y = f(y);
+		for (uLL k = 0; k < r && g == 1; k += block) {
+			ys = y;
+			uLL e = r - k < block ? r - k : block;
+			for (uLL i = 0; i < e; ++i) {
+				y = f(y);
+				q = m.mul(q, x > y ? x - y : y - x);
+			}
+			g = gcd(q, n);
+		}
+		steps += 2 * r;
+		r *= 2;
+		if (g == 1 && steps > max_steps)
+			return 0;
+	}
+	if (g == n)	// the block overshot - one step at a time from its start
+		do {
+			ys = f(ys);
+			g = gcd(x > ys ? x - ys : ys - x, n);
+		} while (g == 1);
+	return g;
+}
+
+/* ECM, stage 1 to B1 and the baby step / giant step stage 2 to B2 (D = 210), on
+   x-only Montgomery curves with Suyama's parametrization; no inversions - the curve
+   constant stays a fraction a24 = num / den */
+
+template <class M, class T> struct ecm_curve {
+	const M &m;
+	T num, den;	// (A + 2) / 4
+
+	ecm_curve(const M &m_) : m(m_) {}
+
+	T add(T a, T b) const { return mod_add(a, b, m.n); }
+	T sub(T a, T b) const { return mod_sub(a, b, m.n); }
+
+	void dbl(T x, T z, T &x2, T &z2) const {
+		T s = m.mul(add(x, z), add(x, z)), d = m.mul(sub(x, z), sub(x, z)), t = sub(s, d);
+		x2 = m.mul(m.mul(s, d), den);
+		z2 = m.mul(t, add(m.mul(d, den), m.mul(num, t)));
+	}
+
+	/* P + Q from P, Q and P - Q */
+	void dadd(T xp, T zp, T xq, T zq, T xd, T zd, T &x3, T &z3) const {
+		T u = m.mul(sub(xp, zp), add(xq, zq)), v = m.mul(add(xp, zp), sub(xq, zq));
+		T s = add(u, v), d = sub(u, v);
+		x3 = m.mul(zd, m.mul(s, s));
+		z3 = m.mul(xd, m.mul(d, d));
+	}
+
+	/* k * P, Montgomery ladder */
+	void ladder(T &x, T &z, uLL k) const {
+		if (k == 1)
+			return;
+		T x0 = x, z0 = z, x1, z1;
+		dbl(x, z, x1, z1);
+		for (int b = 62 - __builtin_clzll(k); b >= 0; --b) {
+			if (k >> b & 1) {
+				dadd(x1, z1, x0, z0, x, z, x0, z0);
+				dbl(x1, z1, x1, z1);
+			}
+			else {
+				dadd(x0, z0, x1, z1, x, z, x1, z1);
+				dbl(x0, z0, x0, z0);
+			}
+		}
+		x = x0;
+		z = z0;
+	}
+};
+
+/* primes up to B2 + D and the stage 2 pairs, shared by all curves of one B1 */
+
+struct ecm_plan {
+	uLL B1, B2;
+	std::vector<unsigned> primes;		// up to B1
+	std::vector<unsigned> baby;		// odd i < D/2 prime to D
+	std::vector<uint32_t> pairs;		// per giant step g: bit j <-> g D +- baby[j] prime
+
+	static const unsigned D = 210;
+
+	ecm_plan(uLL b1, uLL b2) : B1(b1), B2(b2) {
+		std::vector<unsigned> all = small_primes((unsigned) (B2 + D));
+		std::vector<char> is(B2 + D + 1, 0);
+		for (size_t i = 0; i < all.size(); ++i) {
+			is[all[i]] = 1;
+			if (all[i] <= B1)
+				primes.push_back(all[i]);
+		}
+		for (unsigned i = 1; i < D / 2; i += 2)
+			if (i % 3 && i % 5 && i % 7)
+				baby.push_back(i);
+		uLL m_first = B1 / D, m_last = (B2 + D / 2) / D;
+		pairs.resize(m_last + 1);
+		for (uLL g = m_first > 0 ? m_first : 1; g <= m_last; ++g) {
+			uint32_t bits = 0;
+			for (size_t j = 0; j < baby.size(); ++j) {
+				uLL a = g * D - baby[j], b = g * D + baby[j];
+				if ((a > B1 && a <= B2 && is[a]) || (b > B1 && b <= B2 && is[b]))
+					bits |= 1U << j;
+			}
+			pairs[g] = bits;
+		}
+	}
+};
+
+/* one curve, sigma >= 6; a factor of n, 1 or n */
+
+template <class M, class T> T ecm_one(const M &m, const ecm_plan &plan, uLL sigma) {
+	ecm_curve<M, T> e(m);
+	T n = m.n;
+	T s = m.to(sigma);
+	T u = mod_sub(m.mul(s, s), m.to(5), n), v = mod_add(mod_add(s, s, n), mod_add(s, s, n), n);
+	T x = m.mul(m.mul(u, u), u), z = m.mul(m.mul(v, v), v);
+	T vu = mod_sub(v, u, n), u3 = mod_add(mod_add(u, u, n), u, n);
+	e.num = m.mul(m.mul(m.mul(vu, vu), vu), mod_add(u3, v, n));
+	T sixteen = m.to(16);
+	e.den = m.mul(m.mul(sixteen, x), v);	// 16 u^3 v
+	T g = gcd(m.from(e.den), n);
+	if (g != 1)
+		return g;
+	// stage 1: every prime power <= B1
+	for (size_t i = 0; i < plan.primes.size(); ++i) {
+		uLL p = plan.primes[i], q = p;
+		while (q <= plan.B1 / p)
+			q *= p;
+		e.ladder(x, z, q);
+	}
+	g = gcd(m.from(z), n);
+	if (g != 1)
+		return g;
+	// stage 2: product of x_i z_g - x_g z_i for the pairs g D +- i with a prime
+	const unsigned D = ecm_plan::D;
+	std::vector<T> bx(D / 2), bz(D / 2);	// i Q for odd i
+	T x2, z2;
+	e.dbl(x, z, x2, z2);
+	bx[1] = x;
+	bz[1] = z;
+	e.dadd(x2, z2, x, z, x, z, bx[3], bz[3]);
+	for (unsigned i = 5; i < D / 2; i += 2)
+		e.dadd(bx[i - 2], bz[i - 2], x2, z2, bx[i - 4], bz[i - 4], bx[i], bz[i]);
+	T gx = x, gz = z;	// D Q
+	e.ladder(gx, gz, D);
+	uLL first = plan.B1 / D > 0 ? plan.B1 / D : 1;
+	T px = gx, pz = gz, ox = x, oz = z;	// g D Q and (g - 1) D Q
+	bool have_prev = false;
+	if (first > 1) {
+		px = x, pz = z;
+		e.ladder(px, pz, first * D);
+		ox = x, oz = z;
+		e.ladder(ox, oz, (first - 1) * D);
+		have_prev = true;
+	}
+	T acc = m.one;
+	for (uLL k = first; k < plan.pairs.size(); ++k) {
+		uint32_t bits = plan.pairs[k];
+		for (; bits; bits &= bits - 1) {
+			unsigned i = plan.baby[__builtin_ctz(bits)];
+			acc = m.mul(acc, mod_sub(m.mul(bx[i], pz), m.mul(px, bz[i]), n));
+		}
+		T nx, nz;
+		if (k == 1 && !have_prev)
+			e.dbl(px, pz, nx, nz);	// 2 D Q
+		else
+			e.dadd(px, pz, gx, gz, ox, oz, nx, nz);
+		ox = px, oz = pz;
+		px = nx, pz = nz;
+	}
+	return gcd(m.from(acc), n);
+}
+
+/* ECM levels as in GMP-ECM's table: B1 and number of curves for 15, 20, 25, 30, 35 digits */
+
+const uLL ecm_b1[] = { 2000, 11000, 50000, 250000, 1000000 };
+const unsigned ecm_curves[] = { 25, 90, 300, 700, 1800 };
+
+inline const ecm_plan &ecm_level(size_t i) {
+	static ecm_plan *plans[5];
+	static omp_lock_t lock;
+	static bool init = (omp_init_lock(&lock), true);
+	(void) init;
+	omp_set_lock(&lock);
+	if (!plans[i])
+		plans[i] = new ecm_plan(ecm_b1[i], 50 * ecm_b1[i]);
+	omp_unset_lock(&lock);
+	return *plans[i];
+}
+
+/* small prime factors go to out, the cofactor is returned */
+
+const unsigned factor_trial_limit = 1000;
+
+template <class T> T trial_factors(T n, std::vector<T> &out) {
+	static const std::vector<unsigned> small = small_primes(factor_trial_limit);
+	for (size_t i = 0; i < small.size(); ++i) {
+		T p = small[i];
+		if (p * p > n)
+			break;
+		while (n % p == 0) {
+			out.push_back(p);
+			n /= p;
+		}
+	}
+	if (n > 1 && n < (T) factor_trial_limit * factor_trial_limit) {
+		out.push_back(n);
+		n = 1;
+	}
+	return n;
+}
+
+/* a proper divisor of composite odd n without factors below factor_trial_limit */
+
+inline uint64_t find_factor64(uint64_t n) {
+	montgomery64 m(n);
+	for (uint64_t c = 1;; ++c) {
+		uint64_t d = pollard_brent<montgomery64, uint64_t>(m, c, m.to(c + 1), ~0ULL);
+		if (d != 1 && d != n)
+			return d;
+	}
+}
+
+inline u128 find_factor128(u128 n) {
+	montgomery128 m(n);
+	// rho first, cheap for factors up to ~2^40
+	for (uint64_t c = 1; c <= 2; ++c) {
+		u128 d = pollard_brent<montgomery128, u128>(m, c, m.to(c + 1), 1 << 22);
+		if (d > 1 && d < n)
+			return d;
+	}
+	uLL sigma = 6 + (uLL) (n % 1000003);
+	for (size_t level = 0; level < sizeof(ecm_b1) / sizeof(ecm_b1[0]); ++level) {
+		const ecm_plan &plan = ecm_level(level);
+		for (unsigned c = 0; c < ecm_curves[level]; ++c) {
+			u128 d = ecm_one<montgomery128, u128>(m, plan, sigma++);
+			if (d > 1 && d < n)
+				return d;
+		}
+	}
+	for (uint64_t c = 3;; ++c) {	// last resort - rho without a limit
+		u128 d = pollard_brent<montgomery128, u128>(m, c, m.to(c + 1), ~0ULL);
+		if (d > 1 && d < n)
+			return d;
+	}
+}
+
+/* floor(sqrt(n)) */
+
+inline u128 isqrt128(u128 n) {
+	u128 r = (u128) sqrtl((long double) n);
+	while (r > 0 && r > n / r)
+		--r;
+	while ((r + 1) <= n / (r + 1))
+		++r;
+	return r;
+}
+
+inline void factor_rest(u128 n, std::vector<u128> &out) {
+	if (n == 1)
+		return;
+	if (is_prime128(n)) {
+		out.push_back(n);
+		return;
+	}
+	u128 r = isqrt128(n);
+	if (r * r == n) {	// p^2 - hard for rho and ECM alike
+		factor_rest(r, out);
+		factor_rest(r, out);
+		return;
+	}
+	u128 d = n >> 64 ? find_factor128(n) : find_factor64((uint64_t) n);
+	factor_rest(d, out);
+	factor_rest(n / d, out);
+}
+
+/* prime factors with multiplicity, increasing */
+
+inline std::vector<u128> factor128(u128 n) {
+	std::vector<u128> out;
+	if (n < 2)
+		return out;
+	factor_rest(trial_factors(n, out), out);
+	std::sort(out.begin(), out.end());
+	return out;
+}
+
+inline std::vector<uint64_t> factor64(uint64_t n) {
+	std::vector<uint64_t> out;
+	if (n < 2)
+		return out;
+	n = trial_factors(n, out);
+	std::vector<u128> big;
+	factor_rest(n, big);
+	for (size_t i = 0; i < big.size(); ++i)
+		out.push_back((uint64_t) big[i]);
+	std::sort(out.begin(), out.end());
+	return out;
+}
+
+/* factors of n[0..count): the ones of n[i] are factors[offsets[i] .. offsets[i + 1]);
+   numbers are handed out one by one (their cost differs a lot) */
+
+template <class T> void factor_batch(const T *n, size_t count, std::vector<T> &factors,
+	std::vector<size_t> &offsets) {
+	std::vector<std::vector<T> > f(count);
+	long long i;
+#pragma omp parallel for schedule(dynamic)
+	for (i = 0; i < (long long) count; ++i) {
+		std::vector<u128> r = factor128(n[i]);
+		f[i].assign(r.begin(), r.end());
+	}
+	offsets.assign(count + 1, 0);
+	for (size_t j = 0; j < count; ++j)
+		offsets[j + 1] = offsets[j] + f[j].size();
+	factors.resize(offsets[count]);
+	for (size_t j = 0; j < count; ++j)
+		std::copy(f[j].begin(), f[j].end(), factors.begin() + offsets[j]);
+}
+
+#endif
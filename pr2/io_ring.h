@@ -0,0 +1,125 @@
+/* minimal io_uring for asynchronous file writes - raw system calls, no liburing;
+   init() fails on kernels (or sandboxes) without io_uring and callers fall back to pwrite */
+
+#ifndef PR2_IO_RING_H
+#define PR2_IO_RING_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct io_ring {
+	int fd;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_size, cq_size, sqes_size;
+	unsigned pending;	// prepared, not yet submitted
+
+	io_ring() : fd(-1), sqes(NULL), sq_ptr(MAP_FAILED), cq_ptr(MAP_FAILED), pending(0) {}
+	~io_ring() { close(); }
+
+	bool init(unsigned entries) {
+		struct io_uring_params p;
+		memset(&p, 0, sizeof(p));
+		fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+		if (fd < 0)
+			return false;
+		sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+		if (p.features & IORING_FEAT_SINGLE_MMAP)
+			sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+		sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (sq_ptr == MAP_FAILED) {
+			close();
+			return false;
+		}
+		if (p.features & IORING_FEAT_SINGLE_MMAP)
+			cq_ptr = sq_ptr;
+		else {
+			cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+			if (cq_ptr == MAP_FAILED) {
+				close();
+				return false;
+			}
+		}
+		sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+		void *s = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (s == MAP_FAILED) {
+			close();
+			return false;
+		}
+		sqes = (struct io_uring_sqe *) s;
+		char *sq = (char *) sq_ptr, *cq = (char *) cq_ptr;
+		sq_head = (unsigned *) (sq + p.sq_off.head);
+		sq_tail = (unsigned *) (sq + p.sq_off.tail);
+		sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+		sq_array = (unsigned *) (sq + p.sq_off.array);
+		cq_head = (unsigned *) (cq + p.cq_off.head);
+		cq_tail = (unsigned *) (cq + p.cq_off.tail);
+		cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+		cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+		return true;
+	}
+
+	void close() {
+		if (sqes)
+			munmap(sqes, sqes_size);
+		if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+			munmap(cq_ptr, cq_size);
+		if (sq_ptr != MAP_FAILED)
+			munmap(sq_ptr, sq_size);
+		if (fd >= 0)
+			::close(fd);
+		sqes = NULL;
+		sq_ptr = cq_ptr = MAP_FAILED;
+		fd = -1;
+	}
+
+	/* queues a write of buf at offset; data comes back with its completion */
+	bool write(int file, const void *buf, unsigned len, uint64_t offset, uint64_t data) {
+		unsigned tail = *sq_tail;
+		if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > *sq_mask)
+			return false;	// ring full
+		unsigned i = tail & *sq_mask;
+		struct io_uring_sqe *e = &sqes[i];
+		memset(e, 0, sizeof(*e));
+		e->opcode = IORING_OP_WRITE;
+		e->fd = file;
+		e->addr = (uint64_t) (uintptr_t) buf;
+		e->len = len;
+		e->off = offset;
+		e->user_data = data;
+		sq_array[i] = i;
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+		++pending;
+		return true;
+	}
+
+	/* submits the queued writes and waits for one completion: its data and result */
+	bool wait(uint64_t &data, int &result) {
+		for (;;) {
+			unsigned head = *cq_head;
+			if (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+				struct io_uring_cqe *c = &cqes[head & *cq_mask];
+				data = c->user_data;
+				result = c->res;
+				__atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+				return true;
+			}
+			int r = (int) syscall(__NR_io_uring_enter, fd, pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+			if (r < 0 && errno != EINTR)
+				return false;
+			if (r > 0)
+				pending -= (unsigned) r < pending ? (unsigned) r : pending;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,178 @@
+/* running the sieves under a memory cap (a cgroup limit shared with other services):
+
+   memory_budget   - bytes allowed: an argument ("512M", "2G", plain bytes) or PR2_MEMORY,
+                     never above the cgroup limit (memory.max, or memory.limit_in_bytes
+                     of cgroup v1); false for a budget that is not a size, so a typo
+                     is an error rather than no cap at all
+   plan_sieve      - threads, segment size and output slots that fit the budget: the
+                     slots shrink first, then the segments, then the threads go one by
+                     one - slower, but under the cap; not ok when even one thread with
+                     the smallest sizes needs more (the base primes up to sqrt(stop))
+   limit_memory    - RLIMIT_DATA at the budget plus the thread stacks, so a wrong
+                     estimate ends in std::bad_alloc rather than in the OOM killer
+   resident_bytes, peak_resident_bytes - /proc/self/statm and getrusage
+   physical_bytes  - the RAM of the machine; a budget above it caps nothing */
+
+#ifndef PR2_MEMORY_BUDGET_H
+#define PR2_MEMORY_BUDGET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <string>
+#include <iostream>
+
+#include "sieve.h"
+
+typedef unsigned long long uLL;
+
+const uLL budget_headroom = 4 << 20;	// allocator slack, stacks in use, io buffers
+const uLL min_segment = 1 << 16;	// numbers - 512 bytes of bits
+const uLL min_slot = 1 << 16;
+
+/* "123", "64K", "512M", "2G" into n; false when it is not a positive size or does not
+   fit in 64 bits */
+
+inline bool parse_size(const char *s, uLL &n) {
+	if (*s < '0' || *s > '9')	// strtoull would take "-1" and " 1"
+		return false;
+	char *end;
+	errno = 0;
+	n = strtoull(s, &end, 10);
+	if (errno == ERANGE)
+		return false;
+	int shift = 0;
+	switch (*end) {
+	case 'k': case 'K': shift = 10; ++end; break;
+	case 'm': case 'M': shift = 20; ++end; break;
+	case 'g': case 'G': shift = 30; ++end; break;
+	}
+	if (*end || n == 0 || n > (~0ULL >> shift))
+		return false;
+	n <<= shift;
+	return true;
+}
+
+/* the memory limit of our cgroup, 0 when there is none */
+
+inline uLL cgroup_memory_limit() {
+	const char *files[] = { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes" };
+	for (const char *path : files) {
+		FILE *f = fopen(path, "r");
+		if (!f)
+			continue;
+		char line[64] = "";
+		bool read = fgets(line, sizeof(line), f) != NULL;
+		fclose(f);
+		if (!read)
+			continue;
+		uLL n = strtoull(line, NULL, 10);
+		if (n == 0 || n >= (1ULL << 62))	// "max", or v1 without a limit
+			return 0;
+		return n;
+	}
+	return 0;
+}
+
+/* the budget from arg (or PR2_MEMORY when arg is NULL), capped by the cgroup limit;
+   b = 0 - no budget; false when the budget given is not a size */
+
+inline bool memory_budget(const char *arg, uLL &b) {
+	if (!arg)
+		arg = getenv("PR2_MEMORY");
+	b = 0;
+	if (arg && !parse_size(arg, b))
+		return false;
+	uLL cg = cgroup_memory_limit();
+	if (cg && (!b || cg < b))
+		b = cg;
+	return true;
+}
+
+inline uLL physical_bytes() {
+	return (uLL) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+}
+
+inline uLL resident_bytes() {
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	uLL size = 0, resident = 0;
+	if (fscanf(f, "%llu %llu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+inline uLL peak_resident_bytes() {
+	struct rusage u;
+	getrusage(RUSAGE_SELF, &u);
+	return (uLL) u.ru_maxrss * 1024;
+}
+
+struct sieve_plan {
+	uLL budget;		// 0 - unlimited, the plan is the default one
+	uLL fixed;		// resident before the run + headroom
+	int threads;
+	uLL segment;		// numbers per segment of a segment_sieve
+	uLL slot;		// numbers per output slot, 0 - nothing is written
+	uLL slots;
+	uLL slot_bytes;		// text of one slot at most
+	uLL total;		// the estimate
+	bool ok;
+};
+
+/* text of the primes of a slot of n numbers */
+
+inline uLL slot_text(uLL n, size_t line) {
+	return (interval_primes_upper(n) + 1) * line;
+}
+
+/* threads sieving [0, stop) - each with a segment_sieve - and, when slot_max is given,
+   slots_per_thread * threads + extra_slots output slots of line bytes per prime */
+
+inline sieve_plan plan_sieve(uLL budget, uLL stop, int max_threads, uLL slot_max = 0, size_t line = 0,
+			     unsigned slots_per_thread = 0, unsigned extra_slots = 0) {
+	sieve_plan p;
+	p.budget = budget;
+	p.fixed = resident_bytes() + budget_headroom;
+	p.ok = false;
+	for (int t = max_threads; t >= 1 && !p.ok; --t) {
+		uLL slots = slot_max ? (uLL) slots_per_thread * t + extra_slots : 0;
+		for (uLL slot = slot_max ? slot_max : min_slot; slot >= min_slot && !p.ok; slot /= 2)
+			for (uLL seg = segment_numbers; seg >= min_segment && !p.ok; seg /= 2) {
+				p.threads = t;
+				p.segment = slot_max && seg > slot ? slot : seg;
+				p.slot = slot_max ? slot : 0;
+				p.slots = slots;
+				p.slot_bytes = slot_max ? slot_text(slot, line) : 0;
+				p.total = p.fixed + t * segment_sieve::memory(stop, p.segment) + slots * p.slot_bytes;
+				p.ok = !budget || p.total <= budget;
+			}
+	}
+	return p;
+}
+
+inline void print_plan(const sieve_plan &p, std::ostream &out) {
+	out << "Memory plan: " << p.threads << " threads, segments of " << p.segment << " numbers";
+	if (p.slot)
+		out << ", " << p.slots << " slots of " << p.slot << " numbers (" << (p.slot_bytes >> 10) << " KB)";
+	out << ", about " << (p.total >> 20) << " MB";
+	if (p.budget)
+		out << " of " << (p.budget >> 20) << " MB";
+	out << std::endl;
+}
+
+/* the hard cap: private writable memory (heap, mmap, stacks) past the budget fails */
+
+inline bool limit_memory(uLL budget, int threads) {
+	struct rlimit stack, data;
+	if (getrlimit(RLIMIT_STACK, &stack) != 0 || stack.rlim_cur == RLIM_INFINITY)
+		stack.rlim_cur = 8 << 20;
+	data.rlim_cur = data.rlim_max = budget + (uLL) (threads + 1) * stack.rlim_cur;
+	return setrlimit(RLIMIT_DATA, &data) == 0;
+}
+
+#endif
@@ -0,0 +1,267 @@
+/* the methods of first_method.cpp, second_method.cpp and kopia (2).cpp in one place,
+   all with one interface: prime[i] for 0 <= i <= n, true for the primes (the caller
+   allocates n + 1 flags, the threads come from omp_set_num_threads)
+
+   sieve_sequential      - Eratosthenes over the whole table
+   sieve_parallel        - the same, the base primes split between the threads
+   sieve_blocked         - the table in cache-sized blocks, one block per thread
+                           ("one access to memory")
+   division_sequential   - trial division by the primes up to sqrt(i)
+   division_parallel     - the same, numbers split dynamically
+   division_blocked      - the same, equal chunks written straight into the table
+   division_ordered      - the same chunks into one sorted list of the primes, through
+                           per-chunk buffers and prefix sums (first_method.cpp; a list,
+                           so it is not in methods[])
+   division_inverse      - the same without div (trial_division.h kernels)
+   division_scheduled    - division, chunks of equal predicted work (division_schedule.h)
+   sieve_segmented       - segment_sieve of sieve.h, the reference
+
+   the divisions take the base primes from prime_tables.h, so n < 2^32; alloc_flags
+   gives the table on 2 MB pages (big_alloc.h) */
+
+#ifndef PR2_METHODS_H
+#define PR2_METHODS_H
+
+#include <string.h>
+#include <omp.h>
+#include <vector>
+#include <algorithm>
+
+#include "sieve.h"
+#include "trial_division.h"
+#include "prime_tables.h"
+#include "division_schedule.h"
+#include "big_alloc.h"
+
+// one table for every n: the divisions stop at sqrt(i) and divisors() cuts the view of
+// the kernels at sqrt(n), so primes up to sqrt(division_limit) cost only the binary
+typedef small_prime_table<65536> division_primes;
+const uLL method_block = 6 * 1024 * 1024;	// sieve_blocked, numbers per block
+const uLL division_limit = 0xfffffffeULL;	// n + 1 fits the 32-bit kernels
+
+typedef void (*prime_method)(uLL n, bool *prime);
+
+/* sieve of Eratosthenes - sequential */
+
+inline void sieve_sequential(uLL n, bool *prime) {
+	memset(prime, 1, n + 1);
+	prime[0] = false;
+	if (n >= 1)
+		prime[1] = false;
+	for (uLL i = 2; i * i <= n; ++i)
+		if (prime[i])
+			for (uLL j = i * i; j <= n; j += i)
+				prime[j] = false;
+}
+
+/* sieve of Eratosthenes - parallel over the base primes (a lot of accesses to memory);
+   a thread may see a composite as prime before its factor is crossed off - it then
+   crosses off multiples of a composite, wasted work but no wrong flag */
+
+inline void sieve_parallel(uLL n, bool *prime) {
+	memset(prime, 1, n + 1);
+	prime[0] = false;
+	if (n >= 1)
+		prime[1] = false;
+	long long s = (long long) isqrt(n), i;
+#pragma omp parallel for schedule(dynamic)
+	for (i = 2; i <= s; ++i)
+		if (prime[i])
+			for (uLL j = (uLL) i * i; j <= n; j += i)
+				prime[j] = false;
+}
+
+/* sieve of Eratosthenes - blocks of method_block numbers, each crossed off by all the
+   base primes while it is in the cache (one access to memory) */
+
+inline void sieve_blocked(uLL n, bool *prime) {
+	uLL s = isqrt(n);
+	sieve_sequential(s, prime);
+	std::vector<unsigned> base;
+	for (uLL i = 2; i <= s; ++i)
+		if (prime[i])
+			base.push_back((unsigned) i);
+	long long blocks = (long long) ((n - s) / method_block + 1), b;
+#pragma omp parallel for schedule(dynamic)
+	for (b = 0; b < blocks; ++b) {
+		uLL lo = s + 1 + b * method_block;
+		uLL hi = lo + method_block - 1 < n ? lo + method_block - 1 : n;
+		if (lo > hi)
+			continue;
+		memset(prime + lo, 1, hi - lo + 1);
+		for (size_t k = 0; k < base.size(); ++k) {
+			uLL p = base[k];
+			uLL j = p * p > lo ? p * p : (lo + p - 1) / p * p;
+			for (; j <= hi; j += p)
+				prime[j] = false;
+		}
+	}
+}
+
+/* is i prime, trial division by the primes up to sqrt(i); the wheel of 210 sorts out
+   the multiples of 2, 3, 5 and 7 first, so the divisions start at 11 */
+
+inline bool divide(uLL i) {
+	if (i < 11)
+		return i == 2 || i == 3 || i == 5 || i == 7;
+	if (wheel210::index[i % wheel210::modulus] < 0)
+		return false;
+	for (size_t k = 4; k < division_primes::count; ++k) {
+		uLL p = division_primes::primes[k];
+		if (p * p > i)
+			break;
+		if (i % p == 0)
+			return false;
+	}
+	return true;
+}
+
+/* division by primes less then sqrt - sequential */
+
+inline void division_sequential(uLL n, bool *prime) {
+	for (uLL i = 0; i <= n; ++i)
+		prime[i] = divide(i);
+}
+
+/* division by primes less then sqrt - parallel (a lot of accesses to memory) */
+
+inline void division_parallel(uLL n, bool *prime) {
+	long long i;
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (i = 0; i <= (long long) n; ++i)
+		prime[i] = divide(i);
+}
+
+/* division by primes less then sqrt - 16 equal chunks per thread, each written straight
+   into its own part of the table (one access to memory per number) */
+
+inline void division_blocked(uLL n, bool *prime) {
+	const long long chunks = 16 * omp_get_max_threads();
+	const uLL chunk = (n + chunks) / chunks;
+	long long c;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (c = 0; c < chunks; ++c) {
+		uLL from = c * chunk, to = from + chunk < n + 1 ? from + chunk : n + 1;
+		for (uLL i = from; i < to; ++i)
+			prime[i] = divide(i);
+	}
+}
+
+/* the primes up to n as a sorted list, not flags (first_method.cpp): the same chunks,
+   each collects its primes in its own buffer, prefix sums of the buffer sizes give every
+   chunk its offset in the list and the buffers are copied there in parallel - no lock */
+
+inline void division_ordered(uLL n, std::vector<uLL> &list) {
+	const long long chunks = 16 * omp_get_max_threads();
+	const uLL chunk = (n + chunks) / chunks;
+	std::vector<std::vector<uLL> > found(chunks);
+	std::vector<uLL> offset(chunks + 1, 0);
+	long long c;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (c = 0; c < chunks; ++c) {
+		uLL from = c * chunk, to = from + chunk < n + 1 ? from + chunk : n + 1;
+		for (uLL i = from; i < to; ++i)
+			if (divide(i))
+				found[c].push_back(i);
+	}
+	for (c = 0; c < chunks; ++c)
+		offset[c + 1] = offset[c] + found[c].size();
+	list.resize(offset[chunks]);
+#pragma omp parallel for schedule(static)
+	for (c = 0; c < chunks; ++c)
+		std::copy(found[c].begin(), found[c].end(), list.begin() + offset[c]);
+}
+
+/* division by primes less then sqrt - no div instruction, the best kernel of the CPU */
+
+inline void division_inverse(uLL n, bool *prime) {
+	static const trial_division_kernel kernel = select_trial_division();
+	divisor_view d = division_primes::divisors((uint32_t) isqrt(n));
+	const uLL chunk = 64 * 1024;
+	long long c, chunks = (long long) (n / chunk + 1);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (c = 0; c < chunks; ++c) {
+		uLL lo = c * chunk, hi = lo + chunk < n + 1 ? lo + chunk : n + 1;
+		kernel((uint32_t) lo, (uint32_t) hi, d, prime);
+	}
+}
+
+/* division by primes less then sqrt - chunks cut by the cost model, heaviest first */
+
+inline void division_scheduled(uLL n, bool *prime) {
+	division_scheduler s(0, n + 1, omp_get_max_threads());
+	s.run([&](uLL from, uLL to) {
+		for (uLL i = from; i < to; ++i)
+			prime[i] = divide(i);
+	});
+}
+
+/* segmented sieve of sieve.h, segments split between the threads */
+
+inline void sieve_segmented(uLL n, bool *prime) {
+	memset(prime, 0, n + 1);
+	if (n >= 2)
+		prime[2] = true;
+	const uLL chunk = 16 * segment_numbers;
+	long long c, chunks = (long long) (n / chunk + 1);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (c = 0; c < chunks; ++c) {
+		uLL lo = c * chunk, hi = lo + chunk < n + 1 ? lo + chunk : n + 1;
+		segment_sieve s(lo, hi);
+		while (s.next_segment())
+			s.each([&](uLL p) { prime[p] = true; });
+	}
+}
+
+struct method_info {
+	const char *name;
+	prime_method run;
+	bool division;		// trial division - O(n sqrt(n) / log(n)), only for small n
+};
+
+const method_info methods[] = {
+	{ "sieve_sequential", sieve_sequential, false },
+	{ "sieve_parallel", sieve_parallel, false },
+	{ "sieve_blocked", sieve_blocked, false },
+	{ "sieve_segmented", sieve_segmented, false },
+	{ "division_sequential", division_sequential, true },
+	{ "division_parallel", division_parallel, true },
+	{ "division_blocked", division_blocked, true },
+	{ "division_inverse", division_inverse, true },
+	{ "division_scheduled", division_scheduled, true },
+};
+const size_t method_count = sizeof(methods) / sizeof(methods[0]);
+
+/* n + 1 zeroed flags on transparent huge pages, first touched by the threads block by
+   block; NULL when they cannot be mapped, big_free(b) releases them */
+
+inline bool *alloc_flags(uLL n, big_buffer &b) {
+	b = big_alloc(n + 1, alloc_thp, method_block);
+	return (bool *) b.p;
+}
+
+/* time of one run of m over [0, n] with the given threads */
+
+inline double time_method(prime_method m, uLL n, bool *prime, int threads) {
+	omp_set_num_threads(threads);
+	double start = omp_get_wtime();
+	m(n, prime);
+	return omp_get_wtime() - start;
+}
+
+/* pi(10^k), k = 0..12 */
+
+const uLL pi_powers_of_ten[] = { 0, 4, 25, 168, 1229, 9592, 78498, 664579, 5761455, 50847534,
+				 455052511, 4118054813ULL, 37607912018ULL };
+
+/* pi(n) when n is a power of ten up to 10^12, ~0 otherwise */
+
+inline uLL known_pi(uLL n) {
+	uLL p = 1;
+	for (size_t k = 0; k < sizeof(pi_powers_of_ten) / sizeof(pi_powers_of_ten[0]); ++k, p *= 10)
+		if (p == n)
+			return pi_powers_of_ten[k];
+	return ~0ULL;
+}
+
+#endif
@@ -0,0 +1,207 @@
+/* deterministic Miller-Rabin for 64-bit numbers on Montgomery arithmetic
+
+   n < 2^64:   bases 2, 325, 9375, 28178, 450775, 9780504, 1795265022 (Sinclair)
+   n < 2^31:   bases 2, 7, 61 - used by the batch kernel, 8 numbers per AVX-512 vector
+   (odd n >= 64 only, small factors are tested first) */
+
+#ifndef PR2_MILLER_RABIN_H
+#define PR2_MILLER_RABIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "trial_division.h"
+
+typedef unsigned __int128 u128;
+
+/* arithmetic mod odd n in Montgomery form, R = 2^64 */
+
+struct montgomery64 {
+	uint64_t n, inv, one, r2;	// inv = n^-1 mod R, one = R mod n, r2 = R^2 mod n
+
+	montgomery64(uint64_t n_) : n(n_), inv(inverse64(n_)) {
+		one = (uint64_t) (((u128) 1 << 64) % n);
+		r2 = (uint64_t) ((u128) one * one % n);
+	}
+
+	/* a * b / R mod n */
+	uint64_t mul(uint64_t a, uint64_t b) const {
+		u128 t = (u128) a * b;
+		uint64_t m = (uint64_t) t * inv;
+		uint64_t hi = (uint64_t) (t >> 64), mn = (uint64_t) (((u128) m * n) >> 64);
+		return hi >= mn ? hi - mn : hi - mn + n;
+	}
+
+	uint64_t to(uint64_t a) const { return mul(a % n, r2); }
+	uint64_t from(uint64_t a) const { return mul(a, 1); }
+
+	uint64_t pow(uint64_t a, uint64_t e) const {
+		uint64_t r = one;
+		for (; e; e >>= 1) {
+			if (e & 1)
+				r = mul(r, a);
+			a = mul(a, a);
+		}
+		return r;
+	}
+};
+
+/* one strong probable prime round, a in Montgomery form */
+
+inline bool strong_probable_prime(const montgomery64 &m, uint64_t a, uint64_t d, int s) {
+	uint64_t minus_one = m.n - m.one;
+	uint64_t x = m.pow(a, d);
+	if (x == m.one || x == minus_one)
+		return true;
+	for (int i = 1; i < s; ++i) {
+		x = m.mul(x, x);
+		if (x == minus_one)
+			return true;
+		if (x == m.one)
+			return false;
+	}
+	return false;
+}
+
+/* primes below 64 divide out before the Montgomery setup */
+
+const uint32_t mr_small_primes[] = { 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61 };
+
+/* 1 - prime, 0 - composite, -1 - no small factor, Miller-Rabin decides */
+
+inline int small_factor_test(uint64_t n) {
+	if (n < 64)
+		return n == 2 || ((n & 1) && (0x28208a20a08a28acULL >> n & 1));
+	if (!(n & 1))
+		return 0;
+	for (size_t i = 0; i < sizeof(mr_small_primes) / sizeof(mr_small_primes[0]); ++i) {
+		uint32_t p = mr_small_primes[i];
+		if (n * inverse64(p) <= ~0ULL / p)
+			return 0;
+	}
+	return -1;
+}
+
+inline bool is_prime_mr(uint64_t n) {
+	int t = small_factor_test(n);
+	if (t >= 0)
+		return t;
+	static const uint64_t bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+	montgomery64 m(n);
+	int s = __builtin_ctzll(n - 1);
+	uint64_t d = (n - 1) >> s;
+	for (size_t i = 0; i < 7; ++i) {
+		uint64_t a = bases[i] % n;
+		if (a == 0)
+			continue;
+		if (!strong_probable_prime(m, m.to(a), d, s))
+			return false;
+	}
+	return true;
+}
+
+/* 8 odd n in [64, 2^31) per vector, 32-bit Montgomery (R = 2^32) in 64-bit lanes */
+
+// GCC 12 takes the _mm512_undefined_epi32() pass-through of _mm512_mul_epu32 and
+// _mm512_srli_epi64 (avx512fintrin.h) for an uninitialized use wherever they are inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+inline __m512i mont_mul8(__m512i a, __m512i b, __m512i n, __m512i ninv) {
+	const __m512i low = _mm512_set1_epi64(0xffffffff);
+	__m512i t = _mm512_mul_epu32(a, b);
+	__m512i m = _mm512_and_si512(_mm512_mul_epu32(t, ninv), low);	// t * -n^-1 mod R
+	__m512i u = _mm512_srli_epi64(_mm512_add_epi64(t, _mm512_mul_epu32(m, n)), 32);
+	return _mm512_mask_sub_epi64(u, _mm512_cmpge_epu64_mask(u, n), u, n);
+}
+
+__attribute__((target("avx512f")))
+inline void is_prime_mr8(const uint64_t *in, bool *out) {
+	static const uint64_t bases[3] = { 2, 7, 61 };
+	uint64_t nn[8], ninv[8], one[8], r2[8], d[8];
+	int s[8], max_s = 0;
+	for (int i = 0; i < 8; ++i) {
+		nn[i] = in[i];
+		ninv[i] = (uint32_t) -inverse32((uint32_t) nn[i]);
+		one[i] = ((uint64_t) 1 << 32) % nn[i];
+		r2[i] = one[i] * one[i] % nn[i];
+		s[i] = __builtin_ctzll(nn[i] - 1);
+		d[i] = (nn[i] - 1) >> s[i];
+		if (s[i] > max_s)
+			max_s = s[i];
+	}
+	__m512i n = _mm512_loadu_si512(nn), inv = _mm512_loadu_si512(ninv);
+	__m512i vone = _mm512_loadu_si512(one), vr2 = _mm512_loadu_si512(r2);
+	__m512i vd = _mm512_loadu_si512(d);
+	__m512i minus_one = _mm512_sub_epi64(n, vone);
+	__mmask8 prime = 0xff;
+	__mmask8 in_range[32];	// lanes with s > i
+	for (int i = 0; i < max_s; ++i) {
+		in_range[i] = 0;
+		for (int l = 0; l < 8; ++l)
+			in_range[i] |= (__mmask8) ((i < s[l]) << l);
+	}
+	for (int b = 0; b < 3; ++b) {
+		__m512i a = mont_mul8(_mm512_set1_epi64(bases[b]), vr2, n, inv);
+		__m512i x = vone;
+		for (int bit = 30; bit >= 0; --bit) {
+			x = mont_mul8(x, x, n, inv);
+			__mmask8 set = _mm512_test_epi64_mask(vd, _mm512_set1_epi64(1ULL << bit));
+			x = _mm512_mask_mov_epi64(x, set, mont_mul8(x, a, n, inv));
+		}
+		__mmask8 ok = _mm512_cmpeq_epu64_mask(x, vone) | _mm512_cmpeq_epu64_mask(x, minus_one);
+		for (int i = 1; i < max_s; ++i) {
+			x = mont_mul8(x, x, n, inv);
+			ok |= _mm512_cmpeq_epu64_mask(x, minus_one) & in_range[i];
+		}
+		prime &= ok;
+		if (!prime)
+			break;
+	}
+	for (int i = 0; i < 8; ++i)
+		out[i] = (prime >> i) & 1;
+}
+
+#pragma GCC diagnostic pop
+
+/* out[i] = is n[i] prime - parallel over blocks; after the small factors the
+   remaining n < 2^31 go through the vector kernel 8 at a time when the CPU has AVX-512 */
+
+inline void is_prime_batch(const uint64_t *n, size_t count, bool *out) {
+	__builtin_cpu_init();
+	bool simd = __builtin_cpu_supports("avx512f");
+	const size_t block = 1024;
+	long long blocks = (long long) ((count + block - 1) / block);
+	long long b;
+#pragma omp parallel for schedule(dynamic, 4)
+	for (b = 0; b < blocks; ++b) {
+		size_t lo = b * block, hi = lo + block < count ? lo + block : count;
+		size_t left[block], k = 0;	// survivors for the vector kernel
+		for (size_t i = lo; i < hi; ++i) {
+			int t = small_factor_test(n[i]);
+			if (t >= 0)
+				out[i] = t;
+			else if (simd && n[i] < (1ULL << 31))
+				left[k++] = i;
+			else
+				out[i] = is_prime_mr(n[i]);
+		}
+		size_t i = 0;
+		for (; i + 8 <= k; i += 8) {
+			uint64_t v[8];
+			bool r[8];
+			for (int l = 0; l < 8; ++l)
+				v[l] = n[left[i + l]];
+			is_prime_mr8(v, r);
+			for (int l = 0; l < 8; ++l)
+				out[left[i + l]] = r[l];
+		}
+		for (; i < k; ++i)
+			out[left[i]] = is_prime_mr(n[left[i]]);
+	}
+}
+
+#endif
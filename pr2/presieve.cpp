@@ -0,0 +1,93 @@
+/* pre-sieving kernels of presieve.h against crossing off 3..61 bit by bit: every kernel
+   is checked on random segment starts and lengths, then timed per segment
+
+   build: g++ -O2 -fopenmp presieve.cpp -o presieve
+   usage: ./presieve [segments] [limit]     limit - pi(limit) with the pre-sieved sieve */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <random>
+#include <iostream>
+
+#include "sieve.h"
+
+using namespace std;
+
+/* what next_segment() did before: all ones, then one bit per odd multiple */
+
+void crossing_3_61(uLL low, uint64_t *bits, size_t words) {
+	memset(bits, 0xff, words * sizeof(uint64_t));
+	uLL high = low + 128 * words;
+	for (unsigned g = 0; g < presieve_groups; ++g)
+		for (unsigned j = 0; j < 3 && presieve_primes[g][j]; ++j) {
+			uLL p = presieve_primes[g][j];
+			uLL m = low <= p ? 3 * p : (low + p - 1) / p * p;
+			if (!(m & 1))
+				m += p;
+			for (; m < high; m += 2 * p) {
+				uLL k = (m - low - 1) / 2;
+				bits[k / 64] &= ~(1ULL << (k % 64));
+			}
+		}
+}
+
+int main(int argc, char **argv) {
+	int segments = argc > 1 ? atoi(argv[1]) : 2000;
+	uLL limit = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000000;
+	const size_t words = segment_numbers / 128;
+	vector<uint64_t> a(words), b(words);
+
+	const char *best;
+	select_presieve(&best);
+	cout << "Best kernel: " << best << endl;
+
+	struct { const char *name; presieve_kernel k; bool ok; } kernels[] = {
+		{ "scalar", presieve_scalar, true },
+		{ "AVX2", presieve_avx2, __builtin_cpu_supports("avx2") != 0 },
+		{ "AVX-512", presieve_avx512, __builtin_cpu_supports("avx512f") != 0 },
+	};
+	mt19937_64 rng(7);
+	int wrong = 0;
+	for (int t = 0; t < 1000; ++t) {
+		uLL low = (rng() % (1ULL << 50)) & ~1ULL;
+		size_t w = 1 + rng() % words;
+		if (t < 10)
+			low = 2 * t;
+		crossing_3_61(low, &a[0], w);
+		for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+			if (!kernels[i].ok)
+				continue;
+			kernels[i].k(low, &b[0], w);
+			if (low < presieve_max)	// the kernels clear 3..61 themselves
+				b[0] = a[0];
+			if (memcmp(&a[0], &b[0], w * 8)) {
+				++wrong;
+				cout << kernels[i].name << " differs at low = " << low << ", " << w << " words" << endl;
+			}
+		}
+	}
+	cout << "Kernels checked on 1000 segments, " << wrong << " wrong" << endl;
+
+	uLL low = 1ULL << 40;
+	double start = omp_get_wtime();
+	for (int s = 0; s < segments; ++s)
+		crossing_3_61(low + s * segment_numbers, &a[0], words);
+	double base = (omp_get_wtime() - start) / segments;
+	cout << "Crossing off 3..61: " << base * 1e6 << " us per segment" << endl;
+	for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+		if (!kernels[i].ok)
+			continue;
+		start = omp_get_wtime();
+		for (int s = 0; s < segments; ++s)
+			kernels[i].k(low + s * segment_numbers, &b[0], words);
+		double t = (omp_get_wtime() - start) / segments;
+		cout << "Patterns, " << kernels[i].name << ": " << t * 1e6 << " us per segment (x" << base / t << ")" << endl;
+	}
+
+	start = omp_get_wtime();
+	uLL c = count_primes(0, limit + 1);
+	cout << "pi(" << limit << ") = " << c << ": " << omp_get_wtime() - start << endl;
+	return wrong ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+/* pre-sieving of a segment by the primes 3..61 with repeating bit patterns instead of
+   crossing off one bit at a time (bit i <-> low + 2i + 1, as in sieve.h)
+
+   the primes are grouped, (3 5 7) (11 13) (17 19) .. (59 61); the keep-mask of a group
+   with product M repeats every M bits and, since M is odd, every M words - word k of
+   the pattern starts at bit 64k, so the segment starting at bit s of the pattern uses
+   the words from k0 = s * 64^-1 mod M on. A kernel ANDs the patterns of all groups
+   into whole 64/256/512-bit words, moving every group's index by a word / vector per
+   step; the patterns have 8 words of padding, so an unaligned vector load that
+   crosses the end of the period is still valid and the index just wraps around */
+
+#ifndef PR2_PRESIEVE_H
+#define PR2_PRESIEVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <immintrin.h>
+
+typedef unsigned long long uLL;
+
+const unsigned presieve_max = 61;	// largest pre-sieved prime
+const unsigned presieve_groups = 8;
+const unsigned presieve_primes[presieve_groups][3] = {
+	{ 3, 5, 7 }, { 11, 13, 0 }, { 17, 19, 0 }, { 23, 29, 0 },
+	{ 31, 37, 0 }, { 41, 43, 0 }, { 47, 53, 0 }, { 59, 61, 0 }
+};
+const unsigned presieve_pad = 8;
+
+struct presieve_table {
+	unsigned modulus[presieve_groups];
+	unsigned inv64[presieve_groups];		// 64^-1 mod modulus
+	std::vector<uint64_t> keep[presieve_groups];	// modulus + presieve_pad words
+
+	presieve_table() {
+		for (unsigned g = 0; g < presieve_groups; ++g) {
+			unsigned m = 1;
+			for (unsigned j = 0; j < 3 && presieve_primes[g][j]; ++j)
+				m *= presieve_primes[g][j];
+			modulus[g] = m;
+			for (unsigned x = 1; x < m; ++x)
+				if (64ULL * x % m == 1)
+					inv64[g] = x;
+			keep[g].assign(m + presieve_pad, 0);
+			for (uLL b = 0; b < 64ULL * m; ++b) {
+				bool kept = true;
+				for (unsigned j = 0; j < 3 && presieve_primes[g][j]; ++j)
+					if ((2 * b + 1) % presieve_primes[g][j] == 0)
+						kept = false;
+				if (kept)
+					keep[g][b / 64] |= 1ULL << (b % 64);
+			}
+			for (unsigned i = 0; i < presieve_pad; ++i)
+				keep[g][m + i] = keep[g][i];
+		}
+	}
+
+	/* index of the first word of the segment at low in the pattern of group g */
+	size_t start(unsigned g, uLL low) const {
+		uLL s = low / 2 % modulus[g];
+		return (size_t) (s * inv64[g] % modulus[g]);
+	}
+};
+
+inline const presieve_table &presieve_patterns() {
+	static const presieve_table t;
+	return t;
+}
+
+/* bits[0, words) of the segment at low (even), one word per step */
+
+inline void presieve_scalar(uLL low, uint64_t *bits, size_t words) {
+	const presieve_table &t = presieve_patterns();
+	size_t k[presieve_groups];
+	for (unsigned g = 0; g < presieve_groups; ++g)
+		k[g] = t.start(g, low);
+	for (size_t w = 0; w < words; ++w) {
+		uint64_t v = ~0ULL;
+		for (unsigned g = 0; g < presieve_groups; ++g) {
+			v &= t.keep[g][k[g]];
+			if (++k[g] == t.modulus[g])
+				k[g] = 0;
+		}
+		bits[w] = v;
+	}
+}
+
+/* 4 words per step */
+
+__attribute__((target("avx2")))
+inline void presieve_avx2(uLL low, uint64_t *bits, size_t words) {
+	const presieve_table &t = presieve_patterns();
+	size_t k[presieve_groups];
+	for (unsigned g = 0; g < presieve_groups; ++g)
+		k[g] = t.start(g, low);
+	size_t w = 0;
+	for (; w + 4 <= words; w += 4) {
+		__m256i v = _mm256_set1_epi64x(-1);
+		for (unsigned g = 0; g < presieve_groups; ++g) {
+			v = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i *) &t.keep[g][k[g]]));
+			k[g] += 4;
+			if (k[g] >= t.modulus[g])
+				k[g] -= t.modulus[g];
+		}
+		_mm256_storeu_si256((__m256i *) &bits[w], v);
+	}
+	for (; w < words; ++w) {
+		uint64_t v = ~0ULL;
+		for (unsigned g = 0; g < presieve_groups; ++g) {
+			v &= t.keep[g][k[g]];
+			if (++k[g] == t.modulus[g])
+				k[g] = 0;
+		}
+		bits[w] = v;
+	}
+}
+
+/* 8 words per step */
+
+__attribute__((target("avx512f")))
+inline void presieve_avx512(uLL low, uint64_t *bits, size_t words) {
+	const presieve_table &t = presieve_patterns();
+	size_t k[presieve_groups];
+	for (unsigned g = 0; g < presieve_groups; ++g)
+		k[g] = t.start(g, low);
+	size_t w = 0;
+	for (; w + 8 <= words; w += 8) {
+		__m512i v = _mm512_set1_epi64(-1);
+		for (unsigned g = 0; g < presieve_groups; ++g) {
+			v = _mm512_and_si512(v, _mm512_loadu_si512((const void *) &t.keep[g][k[g]]));
+			k[g] += 8;
+			if (k[g] >= t.modulus[g])
+				k[g] -= t.modulus[g];
+		}
+		_mm512_storeu_si512((void *) &bits[w], v);
+	}
+	for (; w < words; ++w) {
+		uint64_t v = ~0ULL;
+		for (unsigned g = 0; g < presieve_groups; ++g) {
+			v &= t.keep[g][k[g]];
+			if (++k[g] == t.modulus[g])
+				k[g] = 0;
+		}
+		bits[w] = v;
+	}
+}
+
+/* best kernel of this CPU */
+
+typedef void (*presieve_kernel)(uLL, uint64_t *, size_t);
+
+inline presieve_kernel select_presieve(const char **name = 0) {
+	const char *dummy;
+	if (!name)
+		name = &dummy;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		*name = "AVX-512";
+		return presieve_avx512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		*name = "AVX2";
+		return presieve_avx2;
+	}
+	*name = "scalar";
+	return presieve_scalar;
+}
+
+/* the words of the segment at low with the multiples of 3..61 cleared, the primes
+   3..61 themselves kept */
+
+inline void presieve(uLL low, uint64_t *bits, size_t words) {
+	static const presieve_kernel kernel = select_presieve();
+	kernel(low, bits, words);
+	if (low < presieve_max)
+		for (unsigned g = 0; g < presieve_groups; ++g)
+			for (unsigned j = 0; j < 3 && presieve_primes[g][j]; ++j) {
+				uLL p = presieve_primes[g][j];
+				uLL i = (p - low - 1) / 2;
+				if (p > low && i < 64 * words)
+					bits[i / 64] |= 1ULL << (i % 64);
+			}
+}
+
+#endif
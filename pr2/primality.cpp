@@ -0,0 +1,114 @@
+/* primality of single 64-bit numbers (Miller-Rabin) and a cross-check of the
+   segmented sieve, count_primes and prime_range with the batch test; without lo hi
+   the check runs a fixed set of ranges, the last ones ending just below 2^64
+
+   build: g++ -O2 -fopenmp primality.cpp -o primality
+   usage: ./primality n ...
+          ./primality check [lo hi]                                        */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <iostream>
+#include <string>
+
+#include "sieve.h"
+#include "prime_range.h"
+#include "miller_rabin.h"
+
+using namespace std;
+
+/* both methods over [lo, hi), every number is tested by Miller-Rabin */
+
+bool cross_check(uLL lo, uLL hi) {
+	double start = omp_get_wtime();
+	vector<char> sieved(hi - lo, 0);
+	if (lo <= 2 && hi > 2)
+		sieved[2 - lo] = 1;
+	segment_sieve s(lo, hi);
+	while (s.next_segment())
+		s.each([&](uLL p) { sieved[p - lo] = 1; });
+	double stop = omp_get_wtime();
+	cout << "Segmented sieve: " << stop - start << endl;
+
+	vector<uint64_t> n(hi - lo);
+	for (uLL i = 0; i < n.size(); ++i)
+		n[i] = lo + i;
+	bool *tested = new bool[n.size()];
+	start = omp_get_wtime();
+	is_prime_batch(&n[0], n.size(), tested);
+	stop = omp_get_wtime();
+	cout << "Miller-Rabin batch: " << stop - start << endl;
+
+	uLL primes = 0, errors = 0;
+	for (uLL i = 0; i < n.size(); ++i) {
+		primes += sieved[i];
+		if ((bool) sieved[i] != tested[i]) {
+			if (errors++ < 10)
+				cout << "mismatch: " << n[i] << " sieve " << (int) sieved[i]
+				     << ", Miller-Rabin " << tested[i] << endl;
+		}
+	}
+	delete [] tested;
+
+	uLL counted = count_primes(lo, hi), ranged = 0;
+	for (uLL p : prime_range(lo, hi)) {
+		if (p - lo >= n.size() || !sieved[p - lo]) {
+			if (errors++ < 10)
+				cout << "prime_range: " << p << " is not a prime of the sieve" << endl;
+		}
+		++ranged;
+	}
+	if (counted != primes || ranged != primes) {
+		cout << "count_primes " << counted << ", prime_range " << ranged << ", sieve " << primes << endl;
+		++errors;
+	}
+	cout << primes << " primes in [" << lo << ", " << hi << "), " << errors << " mismatches" << endl;
+	return errors == 0;
+}
+
+/* the fixed ranges: small numbers, across 2^32, and up to the top of uLL, where
+   low + size of the last segments would wrap (about a minute - every sieve up there
+   needs the base primes up to 2^32) */
+
+bool check_all() {
+	const uLL top = ~0ULL;
+	const uLL ranges[][2] = { { 0, 1 << 20 }, { (1ULL << 32) - (1 << 19), (1ULL << 32) + (1 << 19) },
+				  { top - (1 << 20), top } };
+	bool ok = true;
+	for (auto &r : ranges)
+		ok = cross_check(r[0], r[1]) && ok;
+	// the open range of primes() ends at the top as well
+	uLL from = top - 1000, last = 0, n = 0, expected = 0;
+	for (uLL p : primes(from)) {
+		last = p;
+		++n;
+	}
+	for (uLL m = from; m < top; ++m)
+		expected += is_prime_mr(m);
+	cout << "primes(" << from << "): " << n << " primes, the last " << last << endl;
+	if (n != expected || last != top - 58) {
+		cout << "should be " << expected << " primes, the last " << top - 58 << endl;
+		ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		cout << "usage: " << argv[0] << " n ..." << endl;
+		cout << "       " << argv[0] << " check [lo hi]" << endl;
+		return 1;
+	}
+	if (string(argv[1]) == "check" && argc == 4)
+		return cross_check(strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10)) ? 0 : 1;
+	if (string(argv[1]) == "check" && argc == 2)
+		return check_all() ? 0 : 1;
+
+	for (int i = 1; i < argc; ++i) {
+		uint64_t n = strtoull(argv[i], NULL, 10);
+		cout << n << ": " << (is_prime_mr(n) ? "prime" : "composite") << endl;
+	}
+	return 0;
+}
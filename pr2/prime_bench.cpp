@@ -0,0 +1,121 @@
+/* every method of methods.h over a grid of sizes x thread counts; each result is
+   compared with sieve_segmented of the same n (every flag) and with the known pi(n)
+   of the powers of ten. Timings go to stdout as JSON, a summary to stderr; the exit
+   code is 1 when any method disagrees, so a script can catch a regression
+
+   build: g++ -O2 -fopenmp prime_bench.cpp -o prime_bench
+   usage: ./prime_bench [sizes [threads [methods [division_max [repeats]]]]] > times.json
+          sizes, threads, methods - comma separated, e.g. 1e6,1e7,1e8 1,2,4 all
+          division_max - largest n for the trial divisions (1e7), repeats - best of (1) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "methods.h"
+
+using namespace std;
+
+vector<string> split(const string &s) {
+	vector<string> out;
+	size_t from = 0, comma;
+	while ((comma = s.find(',', from)) != string::npos) {
+		out.push_back(s.substr(from, comma - from));
+		from = comma + 1;
+	}
+	out.push_back(s.substr(from));
+	return out;
+}
+
+/* 1e8 as well as 100000000 */
+uLL parse_size(const string &s) {
+	return s.find_first_of("eE.") != string::npos ? (uLL) (strtod(s.c_str(), NULL) + 0.5) : strtoull(s.c_str(), NULL, 10);
+}
+
+int main(int argc, char **argv) {
+	vector<string> size_args = split(argc > 1 ? argv[1] : "1e6,1e7,1e8");
+	vector<string> thread_args;
+	if (argc > 2)
+		thread_args = split(argv[2]);
+	else
+		for (int t = 1; t <= omp_get_max_threads(); t *= 2)
+			thread_args.push_back(to_string(t));
+	vector<string> method_args = split(argc > 3 ? argv[3] : "all");
+	uLL division_max = argc > 4 ? parse_size(argv[4]) : 10000000;
+	int repeats = argc > 5 ? atoi(argv[5]) : 1;
+
+	vector<const method_info *> chosen;
+	for (size_t k = 0; k < method_count; ++k)
+		for (size_t a = 0; a < method_args.size(); ++a)
+			if (method_args[a] == "all" || method_args[a] == methods[k].name) {
+				chosen.push_back(&methods[k]);
+				break;
+			}
+	if (chosen.empty()) {
+		cerr << "methods:";
+		for (size_t k = 0; k < method_count; ++k)
+			cerr << ' ' << methods[k].name;
+		cerr << endl;
+		return 1;
+	}
+
+	int failures = 0;
+	bool first = true;
+	cout << "{\"max_threads\": " << omp_get_max_threads() << ", \"results\": [";
+	for (size_t si = 0; si < size_args.size(); ++si) {
+		uLL n = parse_size(size_args[si]);
+		big_buffer reference_table, prime_table;
+		bool *reference = alloc_flags(n, reference_table);
+		bool *prime = alloc_flags(n, prime_table);
+		if (!reference || !prime) {
+			cerr << "no memory for 2 x " << n + 1 << " flags" << endl;
+			big_free(reference_table);
+			big_free(prime_table);
+			++failures;
+			continue;
+		}
+		time_method(sieve_segmented, n, reference, omp_get_max_threads());
+		uLL ref_count = count_flags(reference, n + 1);
+		uLL known = known_pi(n);
+		if (known != ~0ULL && known != ref_count) {
+			cerr << "sieve_segmented: pi(" << n << ") = " << ref_count << ", should be " << known << endl;
+			++failures;
+		}
+		for (size_t mi = 0; mi < chosen.size(); ++mi) {
+			const method_info &m = *chosen[mi];
+			if (m.division && (n > division_max || n > division_limit))
+				continue;
+			for (size_t ti = 0; ti < thread_args.size(); ++ti) {
+				int threads = atoi(thread_args[ti].c_str());
+				double best = 0;
+				for (int r = 0; r < repeats; ++r) {
+					memset(prime, 0, n + 1);
+					double t = time_method(m.run, n, prime, threads);
+					best = r == 0 || t < best ? t : best;
+				}
+				uLL count = count_flags(prime, n + 1);
+				bool same = memcmp(prime, reference, n + 1) == 0;
+				bool ok = same && (known == ~0ULL || count == known);
+				if (!ok) {
+					++failures;
+					cerr << m.name << ", n = " << n << ", " << threads << " threads: " << count << " primes, "
+					     << (same ? "" : "differs from sieve_segmented") << endl;
+				}
+				cerr << m.name << "\t" << n << "\t" << threads << "\t" << best << (ok ? "" : "\tFAILED") << endl;
+				cout << (first ? "\n" : ",\n") << "  {\"method\": \"" << m.name << "\", \"n\": " << n
+				     << ", \"threads\": " << threads << ", \"seconds\": " << best << ", \"pi\": " << count
+				     << ", \"known_pi\": " << (known == ~0ULL ? "null" : to_string(known))
+				     << ", \"ok\": " << (ok ? "true" : "false") << "}";
+				first = false;
+			}
+		}
+		big_free(reference_table);
+		big_free(prime_table);
+	}
+	cout << "\n], \"failures\": " << failures << "}" << endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+/* prime_cache (prime_cache.h): growing the limit against sieving again from 0, and
+   readers checked against Miller-Rabin while the cache grows under them
+
+   build: g++ -O2 -fopenmp prime_cache.cpp -o prime_cache
+   usage: ./prime_cache [limit] [readers]     default 10^9, 2 readers */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <iostream>
+
+#include "prime_cache.h"
+#include "miller_rabin.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+	uLL limit = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000000ULL;
+	int readers = argc > 2 ? atoi(argv[2]) : 2;
+
+	// 4e7 then 8e7: the second step sieves only the new half
+	prime_cache c;
+	double start = omp_get_wtime();
+	c.extend(40000000);
+	double mid = omp_get_wtime();
+	c.extend(80000000);
+	double stop = omp_get_wtime();
+	cout << "extend to 4e7: " << mid - start << ", then to 8e7: " << stop - mid << endl;
+	start = omp_get_wtime();
+	prime_cache fresh(80000000);
+	cout << "from 0 to 8e7: " << omp_get_wtime() - start << endl;
+	cout << "pi(8e7) = " << c.count(0, 80000000) << endl;
+
+	// readers query below the current limit while it doubles up to limit
+	atomic<bool> done(false);
+	atomic<uLL> queries(0), errors(0);
+	vector<thread> t;
+	for (int r = 0; r < readers; ++r)
+		t.push_back(thread([&, r]() {
+			mt19937_64 rng(r);
+			uLL q = 0, e = 0;
+			while (!done) {
+				uLL n = rng() % c.limit();
+				if (c.is_prime(n) != is_prime_mr(n))
+					++e;
+				++q;
+			}
+			queries += q;
+			errors += e;
+		}));
+	start = omp_get_wtime();
+	for (uLL l = 2 * c.limit(); l / 2 < limit; l *= 2)
+		c.extend(l < limit ? l : limit);
+	stop = omp_get_wtime();
+	done = true;
+	for (size_t r = 0; r < t.size(); ++r)
+		t[r].join();
+	cout << "grown to " << c.limit() << " with " << readers << " readers: " << stop - start
+	     << ", " << queries << " queries, " << errors << " wrong" << endl;
+	cout << "pi(" << limit << ") = " << c.count(0, limit) << endl;
+	return errors ? 1 : 0;
+}
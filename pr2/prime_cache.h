@@ -0,0 +1,132 @@
+/* sieve cache that grows: extend(8e7) after extend(4e7) sieves only [4e7, 8e7), the
+   base primes are kept and topped up to the new sqrt. Segments of segment_numbers
+   numbers (bit i <-> low + 2i + 1) never move once published, so readers look them
+   up under a shared lock and read them without one; the new segments are sieved in
+   parallel with no lock held and appended under the exclusive lock at the end */
+
+#ifndef PR2_PRIME_CACHE_H
+#define PR2_PRIME_CACHE_H
+
+#include <omp.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+#include "sieve.h"
+
+struct prime_cache {
+	static const uLL words = segment_numbers / 128;
+
+	mutable std::shared_mutex lock;		// segments (the vector), known
+	std::mutex grow;			// one extension at a time
+	std::vector<std::unique_ptr<uint64_t[]> > segments;
+	uLL known;
+	std::vector<unsigned> base;		// odd base primes, only touched under grow
+	uLL base_limit;
+
+	prime_cache(uLL limit = 0) : known(0), base_limit(1) { extend(limit); }
+
+	/* numbers below limit() are known */
+	uLL limit() const {
+		std::shared_lock<std::shared_mutex> l(lock);
+		return known;
+	}
+
+	/* sieves [limit(), limit) - whole segments, so limit() may end up a bit higher;
+	   extensions are serialized, readers go on in the meantime */
+	void extend(uLL limit) {
+		std::lock_guard<std::mutex> g(grow);
+		uLL have = segments.size();
+		uLL want = (limit + segment_numbers - 1) / segment_numbers;
+		if (want <= have)
+			return;
+		uLL root = isqrt(want * segment_numbers - 1);
+		if (base_limit < root) {
+			base_limit = root > 2 * base_limit ? root : 2 * base_limit;
+			std::vector<unsigned> b = small_primes((unsigned) base_limit);
+			base.assign(b.begin() + 1, b.end());	// odd only
+		}
+		std::vector<std::unique_ptr<uint64_t[]> > fresh(want - have);
+		long long i;
+#pragma omp parallel for schedule(dynamic)
+		for (i = 0; i < (long long) fresh.size(); ++i) {
+			fresh[i].reset(new uint64_t[words]);
+			sieve_segment((have + i) * segment_numbers, fresh[i].get());
+		}
+		std::unique_lock<std::shared_mutex> l(lock);
+		for (size_t j = 0; j < fresh.size(); ++j)
+			segments.push_back(std::move(fresh[j]));
+		known = want * segment_numbers;
+	}
+
+	/* n < limit() */
+	bool is_prime(uLL n) const {
+		if (!(n & 1))
+			return n == 2;
+		const uint64_t *s = segment(n / segment_numbers);
+		uLL k = (n % segment_numbers) / 2;
+		return s[k / 64] >> (k % 64) & 1;
+	}
+
+	/* number of primes in [lo, hi), hi <= limit() */
+	uLL count(uLL lo, uLL hi) const {
+		uLL c = (lo <= 2 && hi > 2) ? 1 : 0;
+		for (uLL sg = lo / segment_numbers; sg * segment_numbers < hi; ++sg) {
+			uLL low = sg * segment_numbers;
+			uLL a = lo > low ? (lo - low) / 2 : 0;	// bits [a, b) of odd n in [lo, hi)
+			uLL b = hi - low < segment_numbers ? (hi - low) / 2 : segment_numbers / 2;
+			c += popcount_range(segment(sg), a, b);
+		}
+		return c;
+	}
+
+	/* f(p) for the primes of [lo, hi) in increasing order, hi <= limit() */
+	template <class F> void each(uLL lo, uLL hi, F f) const {
+		if (lo <= 2 && hi > 2)
+			f(2);
+		for (uLL sg = lo / segment_numbers; sg * segment_numbers < hi; ++sg) {
+			uLL low = sg * segment_numbers;
+			const uint64_t *s = segment(sg);
+			for (uLL i = 0; i < words; ++i)
+				for (uint64_t w = s[i]; w; w &= w - 1) {
+					uLL p = low + 2 * (i * 64 + __builtin_ctzll(w)) + 1;
+					if (p >= hi)
+						return;
+					if (p >= lo)
+						f(p);
+				}
+		}
+	}
+
+	/* segment i, i < limit() / segment_numbers */
+	const uint64_t *segment(uLL i) const {
+		std::shared_lock<std::shared_mutex> l(lock);
+		return segments[i].get();
+	}
+
+	/* odd primes of [low, low + segment_numbers) into bits */
+	void sieve_segment(uLL low, uint64_t *bits) const {
+		memset(bits, 0xff, words * sizeof(uint64_t));
+		uLL high = low + segment_numbers;
+		for (size_t i = 0; i < base.size(); ++i) {
+			uLL p = base[i];
+			if (p * p >= high)
+				break;
+			uLL j = p * p;
+			if (j < low) {
+				j = (low + p - 1) / p * p;
+				if (!(j & 1))
+					j += p;
+			}
+			for (; j < high; j += 2 * p) {
+				uLL k = (j - low) / 2;
+				bits[k / 64] &= ~(1ULL << (k % 64));
+			}
+		}
+		if (low == 0)
+			bits[0] &= ~1ULL;	// 1
+	}
+};
+
+#endif
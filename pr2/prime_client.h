@@ -0,0 +1,96 @@
+/* client of prime_server.cpp - one line per request, one line per answer:
+
+   is_prime n       -> 1 | 0
+   count lo hi      -> number of primes in [lo, hi]
+   nth k            -> k-th prime (nth 1 = 2)
+   list lo hi       -> the primes of [lo, hi] separated by spaces
+   stats            -> several lines, the last one "."
+   errors           -> "error: ..."
+
+   requests may be pipelined: send(), send(), ... then the answers with line() in order */
+
+#ifndef PR2_PRIME_CLIENT_H
+#define PR2_PRIME_CLIENT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+
+#include "prime_writer.h"
+
+typedef unsigned long long uLL;
+
+struct prime_client {
+	int fd;
+	std::string in;		// received, not yet returned by line()
+
+	prime_client() : fd(-1) {}
+	~prime_client() { close(); }
+
+	bool connect(const char *path) {
+		close();
+		sockaddr_un a;
+		memset(&a, 0, sizeof(a));
+		a.sun_family = AF_UNIX;
+		strncpy(a.sun_path, path, sizeof(a.sun_path) - 1);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return false;
+		if (::connect(fd, (sockaddr *) &a, sizeof(a)) != 0) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+		in.clear();
+	}
+
+	/* request without the newline */
+	bool send(const std::string &request) {
+		std::string r = request + '\n';
+		return write_all(fd, r.data(), r.size());
+	}
+
+	/* next answer line, false when the server closed the connection */
+	bool line(std::string &out) {
+		size_t eol;
+		while ((eol = in.find('\n')) == std::string::npos) {
+			char buf[1 << 16];
+			ssize_t r = read(fd, buf, sizeof(buf));
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r <= 0)
+				return false;
+			in.append(buf, r);
+		}
+		out.assign(in, 0, eol);
+		in.erase(0, eol + 1);
+		return true;
+	}
+
+	std::string ask(const std::string &request) {
+		std::string a;
+		if (!send(request) || !line(a))
+			return "error: connection lost";
+		return a;
+	}
+
+	/* the common queries - ~0ULL when the server answered with an error */
+	uLL number(const std::string &request) {
+		std::string a = ask(request);
+		return a.compare(0, 5, "error") == 0 ? ~0ULL : strtoull(a.c_str(), NULL, 10);
+	}
+	uLL is_prime(uLL n) { return number("is_prime " + std::to_string(n)); }
+	uLL count(uLL lo, uLL hi) { return number("count " + std::to_string(lo) + " " + std::to_string(hi)); }
+	uLL nth_prime(uLL k) { return number("nth " + std::to_string(k)); }
+};
+
+#endif
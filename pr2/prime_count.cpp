@@ -0,0 +1,494 @@
+/* prime counting pi(x) without listing the primes - Lagarias-Miller-Odlyzko with the
+   Deleglise-Rivat split of the special leaves (easy leaves from a pi table, hard ones
+   from a segmented sieve run in parallel)
+
+   measured on one thread (g++ 12 -O2, AVX-512 machine, popcnt path), default alpha:
+       x      seconds   S1 + easy   hard leaves   P2
+     1e14        2.6        1.2         1.2        0.2
+     1e15        9.7        4.5         4.6        0.5
+     1e16       34.5       18.2        14.1        2.1
+     1e17        161         80          69         12
+     1e18        655        337         273         45
+   ~x^(2/3) - about 4x per power of ten. The target of pi(1e18) in seconds is NOT met:
+   one core needs about 11 minutes. All three phases are parallel and the setup is
+   small, so T cores should take about 655 / T s plus the barriers between the hard
+   leaf rounds - roughly a minute on 16 cores, 20-30 s on 32, seconds only from ~100
+   cores up (an estimate, not measured - the machine had one core). Getting there on
+   a desktop needs the full Deleglise-Rivat / Gourdon algorithms (x^(2/3) / log^2 x)
+
+   build: g++ -O2 -fopenmp prime_count.cpp -o prime_count
+   usage: ./prime_count x [alpha]                                                  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <iostream>
+
+#include "sieve.h"
+
+using namespace std;
+
+/* pi(n) for n <= limit - odd numbers bitmap with a running count per 64 bits */
+
+struct pi_table {
+	vector<uint64_t> bits;
+	vector<unsigned> cnt;
+
+	pi_table(uLL limit) {
+		bits.assign(limit / 128 + 1, 0);
+		cnt.assign(bits.size(), 0);
+		segment_sieve s(0, limit + 1);
+		while (s.next_segment())
+			s.each([&](uLL p) { bits[p / 128] |= 1ULL << (p / 2 % 64); });
+		unsigned c = 1;	// prime 2
+		for (size_t i = 0; i < bits.size(); ++i) {
+			cnt[i] = c;
+			c += popcount64(bits[i]);
+		}
+	}
+
+	/* with the word operations B (rank_select.h) - the leaves below call it inlined */
+	template <class B> uLL at(uLL n) const {
+		if (n < 2)
+			return 0;
+		uLL k = n / 2 % 64;	// bits 0..k cover the odd numbers <= n of the word
+		uint64_t mask = k == 63 ? ~0ULL : (1ULL << (k + 1)) - 1;
+		if (!(n & 1))
+			mask >>= 1;	// n even - the bit of n+1 is not counted
+		return cnt[n / 128] + B::pop(bits[n / 128] & mask);
+	}
+
+	uLL operator()(uLL n) const {
+		return bits_hw_ok() ? at<bits_hw>(n) : at<bits_generic>(n);
+	}
+};
+
+/* mu(m)*lpf(m) for odd m <= limit, 0 when m is not square-free; index m/2 */
+
+vector<int> mu_lpf_table(uLL limit) {
+	vector<int> t(limit / 2 + 1, 1);
+	vector<unsigned> primes = small_primes((unsigned) limit);
+	// lpf is kept as a positive value first, the sign holds mu
+	vector<unsigned> lpf(limit / 2 + 1, 0);
+	for (size_t i = primes.size(); i-- > 1;) {
+		uLL p = primes[i];
+		for (uLL m = p; m <= limit; m += 2 * p)
+			lpf[m / 2] = (unsigned) p;
+	}
+	for (size_t i = 1; i < primes.size(); ++i) {
+		uLL p = primes[i];
+		for (uLL m = p; m <= limit; m += 2 * p)
+			t[m / 2] = -t[m / 2];
+		for (uLL m = p * p; m <= limit; m += 2 * p * p)
+			t[m / 2] = 0;
+	}
+	for (uLL i = 0; i < t.size(); ++i) {
+		int l = i == 0 ? (int) limit + 1 : (int) lpf[i];	// lpf(1) = infinity
+		t[i] = t[i] * l;
+	}
+	return t;
+}
+
+/* ordinary leaves: sum over odd m <= y of mu(m) * phi(x/m, 1) */
+
+long long ordinary_leaves(uLL x, uLL y, const vector<int> &mu_lpf) {
+	long long sum = 0;
+	long long m;
+#pragma omp parallel for schedule(static) reduction(+:sum)
+	for (m = 1; m <= (long long) y; m += 2) {
+		int v = mu_lpf[m / 2];
+		if (v != 0) {
+			long long phi = (long long) ((x / m + 1) / 2);
+			sum += v > 0 ? phi : -phi;
+		}
+	}
+	return sum;
+}
+
+/* easy special leaves: p > sqrt(y), m = q prime, x/(pq) < y so that
+   phi(x/(pq), b-1) = pi(x/(pq)) - b + 2 (or 1 when x/(pq) < p)
+
+   the hot parts (easy leaves of one p, hard leaves of one part, a chunk of P2) are
+   templates on the word operations of rank_select.h: a popcnt copy inlined into a
+   target("popcnt") function, and the portable one (__builtin_popcountll alone is a
+   libgcc call without -mpopcnt - a quarter of the time at 1e15) */
+
+template <class B> long long easy_leaves_of(uLL x, uLL y, uLL z, long long b, const vector<unsigned> &primes,
+		const pi_table &pi) {
+	long long a = (long long) primes.size() - 1;
+	long long sum = 0;
+	uLL p = primes[b];
+	if (z / p >= y)
+		return 0;
+	long long qi = (long long) pi.at<B>(z / p);	// x/(pq) >= y for q <= z/p - hard leaves
+	if (qi < b)
+		qi = b;
+	++qi;
+	while (qi <= a) {
+		uLL q = primes[qi];
+		uLL n = x / (p * q);
+		if (n < p) {	// trivial leaves, phi = 1
+			sum += a - qi + 1;
+			break;
+		}
+		long long l = (long long) pi.at<B>(n);
+		uLL qmax = x / (p * primes[l]);
+		long long qj = qmax >= y ? a : (long long) pi.at<B>(qmax);
+		sum += (qj - qi + 1) * (l - b + 2);
+		qi = qj + 1;
+	}
+	return sum;
+}
+
+__attribute__((target("popcnt,bmi2"), flatten))
+long long easy_leaves_hw(uLL x, uLL y, uLL z, long long b, const vector<unsigned> &primes, const pi_table &pi) {
+	return easy_leaves_of<bits_hw>(x, y, z, b, primes, pi);
+}
+
+long long easy_leaves(uLL x, uLL y, uLL z, const vector<unsigned> &primes, const pi_table &pi) {
+	long long a = (long long) primes.size() - 1;
+	long long b_start = (long long) pi(isqrt(y)) + 1;
+	long long sum = 0;
+	long long b;
+	const bool hw = bits_hw_ok();
+#pragma omp parallel for schedule(dynamic, 16) reduction(+:sum)
+	for (b = b_start; b <= a; ++b)
+		sum += hw ? easy_leaves_hw(x, y, z, b, primes, pi) : easy_leaves_of<bits_generic>(x, y, z, b, primes, pi);
+	return sum;
+}
+
+/* hard special leaves of [lo, hi) - one thread's part of the sieve; phi[] and leaves[]
+   collect the counts relative to lo, joined later with the other threads' parts */
+
+struct hard_part {
+	long long sum;		// sum of -mu(m) * phi_local(x/(pm))
+	uLL bmax;
+	vector<long long> phi;	// unsieved numbers in [lo, hi) before p_b is crossed off
+	vector<long long> leaves;	// sum of -mu(m) of the leaves of p_b
+};
+
+const int counter_log = 10;	// one counter per 1024 bits of the segment
+
+template <class B> void hard_leaves_part_in(uLL x, uLL y, uLL lo, uLL hi, uLL bmax, const vector<unsigned> &primes,
+		const vector<int> &mu_lpf, const pi_table &pi, hard_part &r) {
+	uLL sqrt_y = isqrt(y);
+	uLL z = x / y;
+	if (lo > 0 && isqrt(x / lo) < y) {
+		uLL bl = pi.at<B>(isqrt(x / lo));
+		if (bl < bmax)
+			bmax = bl;
+	}
+	r.sum = 0;
+	r.bmax = bmax;
+	r.phi.assign(bmax + 1, 0);
+	r.leaves.assign(bmax + 1, 0);
+	if (bmax < 2)
+		return;
+
+	uLL size = segment_numbers / 2;
+	vector<uint64_t> bits(size / 128);
+	vector<int> counters((size / 2) >> counter_log);
+	vector<uLL> next(bmax + 1);
+	for (uLL b = 2; b <= bmax; ++b) {
+		uLL p = primes[b];
+		uLL j = lo <= p ? p : (lo + p - 1) / p * p;
+		if (!(j & 1))
+			j += p;
+		next[b] = j;
+	}
+
+	for (uLL low = lo; low < hi; low += size) {
+		uLL high = low + size < hi ? low + size : hi;
+		uLL n_odd = (high - low) / 2;
+		memset(&bits[0], 0xff, bits.size() * sizeof(uint64_t));
+		for (uLL k = n_odd; k < size / 2; ++k)
+			bits[k / 64] &= ~(1ULL << (k % 64));
+		for (size_t c = 0; c < counters.size(); ++c) {
+			int s = 0;
+			for (size_t w = c << (counter_log - 6); w < (c + 1) << (counter_log - 6); ++w)
+				s += B::pop(bits[w]);
+			counters[c] = s;
+		}
+		uLL bseg = bmax;
+		if (low > 0 && isqrt(x / low) < y) {
+			uLL bl = pi.at<B>(isqrt(x / low));
+			if (bl < bseg)
+				bseg = bl;
+		}
+
+		for (uLL b = 2; b <= bseg; ++b) {
+			uLL p = primes[b];
+			// m with x/(pm) in [low, high) and y/p < m <= y
+			uLL m_hi = low == 0 ? y : x / (p * low);
+			if (m_hi > y)
+				m_hi = y;
+			uLL m_lo = x / high / p;
+			if (m_lo < y / p)
+				m_lo = y / p;
+
+			long long phi_b = r.phi[b];
+			uLL counted = 0;	// bits counted so far: blocks [0, block)
+			size_t block = 0;
+			long long leaves = 0;
+			long long sum = 0;
+			// count of unsieved numbers <= n in the segment, n ascending
+			auto phi_upto = [&](uLL n) -> long long {
+				if (n <= low)
+					return 0;
+				uLL k = (n - low - 1) / 2;	// last bit to count
+				size_t kb = k >> counter_log;
+				while (block < kb)
+					counted += counters[block++];
+				uLL c = counted;
+				size_t w0 = kb << (counter_log - 6);
+				for (size_t w = w0; w < k / 64; ++w)
+					c += B::pop(bits[w]);
+				uint64_t last = bits[k / 64];
+				if (k % 64 != 63)
+					last &= (1ULL << (k % 64 + 1)) - 1;
+				c += B::pop(last);
+				return (long long) c;
+			};
+
+			if (p <= sqrt_y) {
+				for (uLL m = m_hi; m > m_lo; --m) {
+					if (!(m & 1))
+						continue;
+					int v = mu_lpf[m / 2];
+					if (v == 0 || (uLL) (v > 0 ? v : -v) <= p)
+						continue;
+					long long phi = phi_b + phi_upto(x / (p * m));
+					// -mu(m) * phi
+					if (v > 0) {
+						sum -= phi;
+						--leaves;
+					} else {
+						sum += phi;
+						++leaves;
+					}
+				}
+			}
+			else {
+				// m = q prime, p < q <= z/p (the rest are easy leaves)
+				if (m_hi > z / p)
+					m_hi = z / p;
+				if (m_lo < p)
+					m_lo = p;
+				if (m_hi > m_lo) {
+					for (uLL qi = pi.at<B>(m_hi); qi > pi.at<B>(m_lo); --qi) {
+						sum += phi_b + phi_upto(x / (p * primes[qi]));
+						++leaves;
+					}
+				}
+			}
+			r.sum += sum;
+			r.leaves[b] += leaves;
+
+			// unsieved count of the whole segment, then cross off p
+			long long total = 0;
+			for (size_t c = 0; c < counters.size(); ++c)
+				total += counters[c];
+			r.phi[b] += total;
+			uLL j = next[b];
+			for (; j < high; j += 2 * p) {
+				uLL k = (j - low) / 2;
+				counters[k >> counter_log] -= (int) ((bits[k / 64] >> (k % 64)) & 1);
+				bits[k / 64] &= ~(1ULL << (k % 64));
+			}
+			next[b] = j;
+		}
+	}
+}
+
+__attribute__((target("popcnt,bmi2"), flatten))
+void hard_leaves_part_hw(uLL x, uLL y, uLL lo, uLL hi, uLL bmax, const vector<unsigned> &primes,
+		const vector<int> &mu_lpf, const pi_table &pi, hard_part &r) {
+	hard_leaves_part_in<bits_hw>(x, y, lo, hi, bmax, primes, mu_lpf, pi, r);
+}
+
+void hard_leaves_part(uLL x, uLL y, uLL lo, uLL hi, uLL bmax, const vector<unsigned> &primes,
+		const vector<int> &mu_lpf, const pi_table &pi, hard_part &r) {
+	if (bits_hw_ok())
+		hard_leaves_part_hw(x, y, lo, hi, bmax, primes, mu_lpf, pi, r);
+	else
+		hard_leaves_part_in<bits_generic>(x, y, lo, hi, bmax, primes, mu_lpf, pi, r);
+}
+
+/* all hard leaves - rounds of one part per thread, parts grow as the leaves thin out */
+
+long long hard_leaves(uLL x, uLL y, const vector<unsigned> &primes, const vector<int> &mu_lpf,
+		const pi_table &pi) {
+	uLL z = x / y;
+	uLL a = primes.size() - 1;
+	uLL bmax = pi(isqrt(z));
+	uLL sqrt_y = isqrt(y);
+	if (bmax < pi(sqrt_y))
+		bmax = pi(sqrt_y);
+	if (bmax > a)
+		bmax = a;
+
+	int threads = omp_get_max_threads();
+	vector<hard_part> parts(threads);
+	vector<long long> phi(bmax + 1, 0);
+	long long sum = 0;
+	uLL limit = z + 1;
+	uLL part_size = segment_numbers / 2;
+
+	for (uLL low = 0; low < limit;) {
+		double start = omp_get_wtime();
+		int t;
+#pragma omp parallel for schedule(static, 1)
+		for (t = 0; t < threads; ++t) {
+			uLL lo = low + t * part_size;
+			uLL hi = lo + part_size < limit ? lo + part_size : limit;
+			if (lo < limit)
+				hard_leaves_part(x, y, lo, hi, bmax, primes, mu_lpf, pi, parts[t]);
+			else
+				parts[t].bmax = 0, parts[t].sum = 0;
+		}
+		for (t = 0; t < threads; ++t) {
+			hard_part &r = parts[t];
+			sum += r.sum;
+			for (uLL b = 2; b <= r.bmax; ++b) {
+				sum += phi[b] * r.leaves[b];
+				phi[b] += r.phi[b];
+			}
+		}
+		low += threads * part_size;
+		if (omp_get_wtime() - start < 0.1)
+			part_size *= 2;
+	}
+	return sum;
+}
+
+/* P2(x, a) - numbers <= x with two prime factors > y:
+   sum over y < p <= sqrt(x) of pi(x/p) - pi(p) + 1 */
+
+long long p2(uLL x, uLL y, uLL a) {
+	uLL sqrt_x = isqrt(x);
+	if (sqrt_x <= y)
+		return 0;
+	uLL limit = x / y + 1;	// x/p < limit
+	int threads = omp_get_max_threads();
+	uLL chunks = (uLL) threads * 16;
+	uLL chunk = (limit + chunks - 1) / chunks;
+	if (chunk < segment_numbers)
+		chunk = segment_numbers;
+	chunks = (limit + chunk - 1) / chunk;
+
+	vector<uLL> cnt(chunks), partial(chunks), np(chunks);
+	long long c;
+#pragma omp parallel for schedule(dynamic)
+	for (c = 0; c < (long long) chunks; ++c) {
+		uLL lo = c * chunk;
+		uLL hi = lo + chunk < limit ? lo + chunk : limit;
+		// primes p with x/p in [lo, hi)
+		uLL p_lo = x / hi + 1;
+		uLL p_hi = lo == 0 ? sqrt_x : x / lo;
+		if (p_lo <= y)
+			p_lo = y + 1;
+		if (p_hi > sqrt_x)
+			p_hi = sqrt_x;
+		vector<uLL> ps;
+		if (p_lo <= p_hi) {
+			segment_sieve sp(p_lo, p_hi + 1);
+			while (sp.next_segment())
+				sp.each([&](uLL p) { ps.push_back(p); });
+		}
+		// walk the primes downwards, x/p upwards
+		uLL count = (lo <= 2 && hi > 2) ? 1 : 0;
+		uLL sum = 0;
+		size_t i = ps.size();
+		segment_sieve s(lo, hi);
+		while (s.next_segment()) {
+			uLL w = 0, part = 0;	// popcount of words [0, w) of the segment
+			while (i > 0 && x / ps[i - 1] < s.high) {
+				uLL v = x / ps[i - 1];
+				if (v > s.low) {
+					uLL k = (v - s.low - 1) / 2;
+					for (; w < k / 64; ++w)
+						part += popcount64(s.bits[w]);
+					uint64_t last = s.bits[k / 64];
+					if (k % 64 != 63)
+						last &= (1ULL << (k % 64 + 1)) - 1;
+					sum += count + part + popcount64(last);
+				}
+				else
+					sum += count;
+				--i;
+			}
+			count += s.count();
+		}
+		cnt[c] = count;
+		partial[c] = sum;
+		np[c] = ps.size();
+	}
+
+	long long result = 0;
+	uLL pi_lo = 0, b = a;
+	for (uLL c = 0; c < chunks; ++c) {
+		result += (long long) (partial[c] + np[c] * pi_lo);
+		pi_lo += cnt[c];
+		b += np[c];
+	}
+	// minus sum over the primes of pi(p) - 1 = a, a+1, ..., b-1
+	result -= (long long) ((b * (b - 1) - a * (a - 1)) / 2);
+	return result;
+}
+
+/* pi(x) = phi(x, a) + a - 1 - P2(x, a), a = pi(y), y = alpha * x^(1/3) */
+
+uLL prime_count(uLL x, double alpha) {
+	if (x < 100000)
+		return count_primes(0, x + 1);
+	uLL cbrt_x = icbrt(x);
+	if (alpha <= 0) {
+		double l = log((double) x);
+		alpha = l * l / 100;	// tuned on 1e12 - 1e16
+		if (alpha < 1)
+			alpha = 1;
+	}
+	uLL y = (uLL) (alpha * cbrt_x);
+	if (y > isqrt(x))
+		y = isqrt(x);
+	if (y < cbrt_x + 1)
+		y = cbrt_x + 1;
+
+	vector<unsigned> primes(1, 0);	// primes[b] = p_b
+	vector<unsigned> ps = small_primes((unsigned) y);
+	primes.insert(primes.end(), ps.begin(), ps.end());
+	uLL a = primes.size() - 1;
+	pi_table pi(y);
+	vector<int> mu_lpf = mu_lpf_table(y);
+
+	double start = omp_get_wtime();
+	long long s1 = ordinary_leaves(x, y, mu_lpf);
+	long long s2_easy = easy_leaves(x, y, x / y, primes, pi);
+	double t_easy = omp_get_wtime();
+	long long s2_hard = hard_leaves(x, y, primes, mu_lpf, pi);
+	double t_hard = omp_get_wtime();
+	long long p2_sum = p2(x, y, a);
+	double t_p2 = omp_get_wtime();
+	cerr << "y = " << y << ", a = " << a << "; S1 + easy leaves: " << t_easy - start
+	     << ", hard leaves: " << t_hard - t_easy << ", P2: " << t_p2 - t_hard << endl;
+
+	return (uLL) (s1 + s2_easy + s2_hard + (long long) a - 1 - p2_sum);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		cout << "usage: " << argv[0] << " x [alpha]" << endl;
+		return 1;
+	}
+	// 1e15 style or plain digits
+	uLL x = strpbrk(argv[1], "eE.") ? (uLL) strtod(argv[1], NULL) : strtoull(argv[1], NULL, 10);
+	double alpha = argc > 2 ? atof(argv[2]) : 0;
+
+	double start = omp_get_wtime();
+	uLL result = prime_count(x, alpha);
+	double stop = omp_get_wtime();
+	cout << "pi(" << x << ") = " << result << endl;
+	cout << "Prime counting (LMO): " << stop - start << endl;
+	return 0;
+}
@@ -0,0 +1,73 @@
+/* random probable primes (prime_gen.h) - window sieve + Miller-Rabin on the survivors,
+   and the same search testing every odd candidate, to see what the sieve saves
+
+   build: g++ -O2 -fopenmp prime_gen.cpp -o prime_gen
+   usage: ./prime_gen bits [count] [seed]          bits 256..4096, primes in hex
+          ./prime_gen compare bits [seed]          sieve vs Miller-Rabin on everything */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+
+#include "prime_gen.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+	bool compare = argc > 1 && string(argv[1]) == "compare";
+	int a = compare ? 2 : 1;
+	unsigned bits = argc > a ? atoi(argv[a]) : 0;
+	if (bits < 256 || bits > 64 * mp_max_limbs) {
+		cout << "usage: " << argv[0] << " bits [count] [seed]    (256 <= bits <= " << 64 * mp_max_limbs << ")" << endl;
+		cout << "       " << argv[0] << " compare bits [seed]" << endl;
+		return 1;
+	}
+	int count = !compare && argc > a + 1 ? atoi(argv[a + 1]) : 1;
+	int seed_arg = compare ? a + 1 : a + 2;
+	uint64_t seed = argc > seed_arg ? strtoull(argv[seed_arg], NULL, 10) : random_device()();
+	mt19937_64 rng(seed);
+	int rounds = gen_rounds(bits);
+	size_t window = gen_window(bits);
+
+	if (!compare) {
+		double total = 0;
+		for (int i = 0; i < count; ++i) {
+			double start = omp_get_wtime();
+			prime_search s(random_odd(bits, rng), window);
+			mp_num p = s.run(rounds);
+			double t = omp_get_wtime() - start;
+			total += t;
+			cout << mp_hex(p) << endl;
+			cerr << bits << " bits: " << t << " s, " << s.windows << " windows, " << s.tested
+			     << " Miller-Rabin tests, p = start + " << p[0] - s.start[0] << endl;
+		}
+		cerr << count << " primes, " << total / count << " s each, " << omp_get_max_threads()
+		     << " threads, " << rounds << " rounds" << endl;
+		return 0;
+	}
+
+	mp_num x = random_odd(bits, rng);
+	double start = omp_get_wtime();
+	prime_search s(x, window);
+	mp_num p = s.run(rounds);
+	double sieved = omp_get_wtime() - start;
+	cout << "Window sieve: " << sieved << " s, " << s.tested << " Miller-Rabin tests" << endl;
+
+	// every odd candidate, one round of base 2 first, in order
+	start = omp_get_wtime();
+	uLL tested = 0;
+	mp_num q = x;
+	for (;; q = mp_add_small(q, 2)) {
+		++tested;
+		if (mp_probable_prime(q, 1, 0) && mp_probable_prime(q, rounds, 1))
+			break;
+	}
+	double everything = omp_get_wtime() - start;
+	cout << "Miller-Rabin on everything: " << everything << " s, " << tested << " tests" << endl;
+	cout << "same prime: " << (p == q ? "yes" : "NO") << ", x" << everything / sieved << endl;
+	return p == q ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+/* random probable primes of 256..4096 bits, the way key generation looks for them:
+   a random odd start x, a window of the candidates x, x + 2, .. x + 2(W - 1) sieved by
+   the 6541 odd primes below 2^16 (small_prime_table<65536>), Miller-Rabin only on what
+   is left, the survivors split between the threads; the result is the first probable
+   prime of the window. The residues x mod p are computed once, the next window only
+   adds 2W mod p to them
+
+   multi-limb arithmetic of its own (as factor.h for 128 bits): fixed size Montgomery
+   multiplication (CIOS) and a 4-bit window exponentiation, so no GMP is needed. The
+   random start comes from std::random_device / mt19937_64 - a benchmark of the search,
+   not a source of real keys */
+
+#ifndef PR2_PRIME_GEN_H
+#define PR2_PRIME_GEN_H
+
+#include <stdint.h>
+#include <string.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <atomic>
+#include <climits>
+
+#include "miller_rabin.h"
+#include "prime_tables.h"
+
+typedef unsigned long long uLL;
+typedef std::vector<uint64_t> mp_num;	// little-endian 64-bit limbs
+typedef small_prime_table<65536> gen_primes;
+
+const size_t mp_max_limbs = 64;		// 4096 bits
+
+/* a - b over n limbs into out, returns the borrow */
+inline uint64_t mp_sub(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t n) {
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < n; ++i) {
+		u128 d = (u128) a[i] - b[i] - borrow;
+		out[i] = (uint64_t) d;
+		borrow = (uint64_t) (d >> 64) & 1;
+	}
+	return borrow;
+}
+
+/* a >= b over n limbs */
+inline bool mp_geq(const uint64_t *a, const uint64_t *b, size_t n) {
+	for (size_t i = n; i-- > 0;)
+		if (a[i] != b[i])
+			return a[i] > b[i];
+	return true;
+}
+
+/* a + v, the carry out of the top limb is dropped */
+inline mp_num mp_add_small(const mp_num &a, uint64_t v) {
+	mp_num r = a;
+	for (size_t i = 0; i < r.size() && v; ++i) {
+		r[i] += v;
+		v = r[i] < v;
+	}
+	return r;
+}
+
+/* a mod p for p < 2^32 */
+inline uint32_t mp_mod_small(const mp_num &a, uint32_t p) {
+	uint64_t r = 0;
+	for (size_t i = a.size(); i-- > 0;)
+		r = (uint64_t) ((((u128) r << 64) | a[i]) % p);
+	return (uint32_t) r;
+}
+
+inline std::string mp_hex(const mp_num &a) {
+	static const char digits[] = "0123456789abcdef";
+	std::string s;
+	for (size_t i = a.size(); i-- > 0;)
+		for (int b = 60; b >= 0; b -= 4)
+			s += digits[a[i] >> b & 15];
+	size_t z = s.find_first_not_of('0');
+	return z == std::string::npos ? "0" : s.substr(z);
+}
+
+/* arithmetic mod an odd m of n limbs, Montgomery form with R = 2^(64 n) */
+
+struct mp_montgomery {
+	size_t n;
+	mp_num m, one, minus_one;	// R mod m, -R mod m
+	mp_num r2;			// R^2 mod m
+	uint64_t minv;			// -m^-1 mod 2^64
+
+	mp_montgomery(const mp_num &m_) : n(m_.size()), m(m_) {
+		minv = 0 - inverse64(m[0]);
+		// 2^k mod m for k = 64n and 128n by doubling
+		mp_num x(n, 0);
+		x[0] = 1;
+		for (size_t k = 1; k <= 128 * n; ++k) {
+			uint64_t carry = x[n - 1] >> 63;
+			for (size_t i = n; i-- > 1;)
+				x[i] = x[i] << 1 | x[i - 1] >> 63;
+			x[0] <<= 1;
+			if (carry || mp_geq(&x[0], &m[0], n))
+				mp_sub(&x[0], &m[0], &x[0], n);
+			if (k == 64 * n)
+				one = x;
+		}
+		r2 = x;
+		minus_one.resize(n);
+		mp_sub(&m[0], &one[0], &minus_one[0], n);
+	}
+
+	/* out = a b R^-1 mod m, out may be a or b */
+	void mul(const uint64_t *a, const uint64_t *b, uint64_t *out) const {
+		uint64_t t[mp_max_limbs + 2];
+		memset(t, 0, (n + 2) * sizeof(uint64_t));
+		for (size_t i = 0; i < n; ++i) {
+			uint64_t c = 0;
+			for (size_t j = 0; j < n; ++j) {
+				u128 s = (u128) a[j] * b[i] + t[j] + c;
+				t[j] = (uint64_t) s;
+				c = (uint64_t) (s >> 64);
+			}
+			u128 s = (u128) t[n] + c;
+			t[n] = (uint64_t) s;
+			t[n + 1] = (uint64_t) (s >> 64);
+			uint64_t q = t[0] * minv;
+			s = (u128) q * m[0] + t[0];
+			c = (uint64_t) (s >> 64);
+			for (size_t j = 1; j < n; ++j) {
+				s = (u128) q * m[j] + t[j] + c;
+				t[j - 1] = (uint64_t) s;
+				c = (uint64_t) (s >> 64);
+			}
+			s = (u128) t[n] + c;
+			t[n - 1] = (uint64_t) s;
+			t[n] = t[n + 1] + (uint64_t) (s >> 64);
+		}
+		if (t[n] || mp_geq(t, &m[0], n))
+			mp_sub(t, &m[0], t, n);
+		memcpy(out, t, n * sizeof(uint64_t));
+	}
+
+	mp_num to(const mp_num &a) const {
+		mp_num r(n);
+		mul(&a[0], &r2[0], &r[0]);
+		return r;
+	}
+
+	/* b^e, b in Montgomery form, 4-bit fixed window */
+	mp_num pow(const mp_num &b, const mp_num &e) const {
+		std::vector<mp_num> table(16, mp_num(n));
+		table[0] = one;
+		for (int i = 1; i < 16; ++i)
+			mul(&table[i - 1][0], &b[0], &table[i][0]);
+		mp_num r = one;
+		bool started = false;
+		for (size_t i = e.size(); i-- > 0;)
+			for (int s = 60; s >= 0; s -= 4) {
+				if (started)
+					for (int k = 0; k < 4; ++k)
+						mul(&r[0], &r[0], &r[0]);
+				unsigned d = e[i] >> s & 15;
+				if (d) {
+					mul(&r[0], &table[d][0], &r[0]);
+					started = true;
+				}
+			}
+		return r;
+	}
+};
+
+/* Miller-Rabin with the base 2 and rounds - 1 random bases below 2^63 */
+
+inline bool mp_probable_prime(const mp_num &x, int rounds, uint64_t seed) {
+	mp_montgomery M(x);
+	mp_num d = x;
+	d[0] -= 1;			// x is odd, no borrow
+	size_t s = 0;
+	while (!(d[s / 64] >> (s % 64) & 1))
+		++s;
+	for (size_t i = 0; i < d.size(); ++i) {	// d >>= s
+		size_t from = i + s / 64;
+		uint64_t lo = from < d.size() ? d[from] : 0, hi = from + 1 < d.size() ? d[from + 1] : 0;
+		d[i] = s % 64 ? lo >> (s % 64) | hi << (64 - s % 64) : lo;
+	}
+	std::mt19937_64 rng(seed);
+	for (int r = 0; r < rounds; ++r) {
+		mp_num a(x.size(), 0);
+		a[0] = r == 0 ? 2 : 3 + (rng() >> 2);
+		mp_num y = M.pow(M.to(a), d);
+		if (y == M.one || y == M.minus_one)
+			continue;
+		bool witness = true;
+		for (size_t k = 1; k < s && witness; ++k) {
+			M.mul(&y[0], &y[0], &y[0]);
+			if (y == M.minus_one)
+				witness = false;
+			else if (y == M.one)
+				break;
+		}
+		if (witness)
+			return false;
+	}
+	return true;
+}
+
+struct prime_search {
+	mp_num start;			// first candidate (odd)
+	size_t window;			// candidates per window
+	std::vector<uint32_t> residue;	// start of the current window mod gen_primes::primes[k]
+	uLL tested, windows;		// Miller-Rabin calls, windows sieved
+	mp_num base;			// current window start
+
+	prime_search(const mp_num &x, size_t window_) : start(x), window(window_), tested(0), windows(0), base(x) {
+		residue.resize(gen_primes::count);
+		for (size_t k = 1; k < gen_primes::count; ++k)
+			residue[k] = mp_mod_small(x, gen_primes::primes[k]);
+	}
+
+	/* candidates of the current window that no small prime divides */
+	std::vector<uint32_t> sieve_window() const {
+		std::vector<char> composite(window, 0);
+		for (size_t k = 1; k < gen_primes::count; ++k) {
+			uint32_t p = gen_primes::primes[k];
+			// base + 2i = 0 mod p  <=>  i = -residue / 2 mod p
+			uLL i = (uLL) (p - residue[k]) % p * ((p + 1) / 2) % p;
+			for (; i < window; i += p)
+				composite[i] = 1;
+		}
+		std::vector<uint32_t> left;
+		for (size_t i = 0; i < window; ++i)
+			if (!composite[i])
+				left.push_back((uint32_t) i);
+		return left;
+	}
+
+	/* moves to the next window - 2 * window added to the residues */
+	void next_window() {
+		base = mp_add_small(base, 2 * window);
+		for (size_t k = 1; k < gen_primes::count; ++k) {
+			uint32_t p = gen_primes::primes[k];
+			residue[k] = (uint32_t) ((residue[k] + 2 * window % p) % p);
+		}
+	}
+
+	/* the first probable prime from start on */
+	mp_num run(int rounds) {
+		for (;; next_window()) {
+			++windows;
+			std::vector<uint32_t> left = sieve_window();
+			std::atomic<long long> best(LLONG_MAX);
+			std::atomic<uLL> calls(0);
+			long long j;
+#pragma omp parallel for schedule(dynamic, 1)
+			for (j = 0; j < (long long) left.size(); ++j) {
+				if (j > best)
+					continue;
+				++calls;
+				if (!mp_probable_prime(mp_add_small(base, 2ULL * left[j]), rounds, left[j]))
+					continue;
+				long long b = best;
+				while (j < b && !best.compare_exchange_weak(b, j))
+					;
+			}
+			tested += calls;
+			if (best != LLONG_MAX)
+				return mp_add_small(base, 2ULL * left[best]);
+		}
+	}
+};
+
+/* odd random number of exactly bits bits (top bit set) */
+
+inline mp_num random_odd(unsigned bits, std::mt19937_64 &rng) {
+	mp_num x((bits + 63) / 64);
+	for (size_t i = 0; i < x.size(); ++i)
+		x[i] = rng();
+	if (bits % 64)
+		x.back() &= (1ULL << (bits % 64)) - 1;
+	x.back() |= 1ULL << ((bits - 1) % 64);
+	x[0] |= 1;
+	return x;
+}
+
+/* Miller-Rabin rounds - a random composite passes one round with a probability that
+   falls fast with its size (Damgard, Landrock, Pomerance), so the larger numbers need
+   fewer rounds for the same error; candidates per window - about 16 primes expected */
+
+inline int gen_rounds(unsigned bits) {
+	return bits >= 2048 ? 4 : bits >= 1024 ? 5 : bits >= 512 ? 8 : 16;
+}
+
+inline size_t gen_window(unsigned bits) {
+	return 16 * (size_t) bits;
+}
+
+#endif
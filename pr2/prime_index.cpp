@@ -0,0 +1,119 @@
+/* building and querying the on-disk prime index (prime_index.h)
+
+   build: g++ -O2 -fopenmp prime_index.cpp -o prime_index
+   usage: ./prime_index build primes.idx 1000000000
+          ./prime_index primes.idx is_prime|next_prime|prev_prime|pi|nth_prime n ... */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <iostream>
+#include <fstream>
+
+#include "sieve.h"
+#include "prime_index.h"
+
+using namespace std;
+
+/* sieves [0, limit] in parallel chunks of whole blocks and writes the index file */
+
+bool build_index(const char *path, uLL limit) {
+	const uLL block_numbers = numbers_per_word * words_per_block;
+	uLL blocks = limit / block_numbers + 1;
+	uLL words = blocks * words_per_block;
+	vector<uint64_t> bits(words, 0);
+	vector<uLL> ranks(blocks, 0);
+
+	double start = omp_get_wtime();
+	const uLL chunk_blocks = 4096;
+	long long chunks = (long long) ((blocks + chunk_blocks - 1) / chunk_blocks);
+	long long c;
+#pragma omp parallel for schedule(dynamic)
+	for (c = 0; c < chunks; ++c) {
+		uLL lo = c * chunk_blocks * block_numbers;
+		uLL hi = lo + chunk_blocks * block_numbers;
+		if (hi > limit + 1)
+			hi = limit + 1;
+		if (lo < 7)
+			lo = 7;
+		if (lo >= hi)
+			continue;
+		segment_sieve s(lo, hi);
+		while (s.next_segment())
+			s.each([&](uLL p) {
+				uLL w = p / numbers_per_word;
+				bits[w] |= 1ULL << (8 * (p % numbers_per_word / 30) + wheel_bit[p % 30]);
+			});
+	}
+	uLL count = 0;
+	for (uLL b = 0; b < blocks; ++b) {
+		ranks[b] = count;
+		for (uLL w = b * words_per_block; w < (b + 1) * words_per_block; ++w)
+			count += __builtin_popcountll(bits[w]);
+	}
+	double stop = omp_get_wtime();
+	cout << "Index sieve: " << stop - start << endl;
+
+	index_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, index_magic, 8);
+	h.limit = limit;
+	h.words = words;
+	h.count = count + small_count(limit);
+
+	ofstream f(path, ios::binary);
+	f.write((const char *) &h, sizeof(h));
+	f.write((const char *) &bits[0], words * sizeof(uint64_t));
+	f.write((const char *) &ranks[0], blocks * sizeof(uLL));
+	f.close();
+	if (!f) {
+		cerr << "cannot write " << path << endl;
+		return false;
+	}
+	cout << "pi(" << limit << ") = " << h.count << ", " << path << ": "
+	     << sizeof(h) + (words + blocks) * 8 << " bytes" << endl;
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc >= 4 && string(argv[1]) == "build")
+		return build_index(argv[2], strtoull(argv[3], NULL, 10)) ? 0 : 1;
+	if (argc < 4) {
+		cout << "usage: " << argv[0] << " build file limit" << endl;
+		cout << "       " << argv[0] << " file is_prime|next_prime|prev_prime|pi|nth_prime n ..." << endl;
+		return 1;
+	}
+
+	double start = omp_get_wtime();
+	prime_index idx;
+	if (!idx.open(argv[1])) {
+		cerr << "cannot open index " << argv[1] << endl;
+		return 1;
+	}
+	double opened = omp_get_wtime();
+	string op = argv[2];
+	for (int i = 3; i < argc; ++i) {
+		uLL n = strtoull(argv[i], NULL, 10);
+		if (op != "nth_prime" && n > idx.limit()) {
+			cout << n << ": above the index limit " << idx.limit() << endl;
+			continue;
+		}
+		if (op == "is_prime")
+			cout << n << ": " << (idx.is_prime(n) ? "prime" : "composite") << endl;
+		else if (op == "next_prime")
+			cout << idx.next_prime(n) << endl;
+		else if (op == "prev_prime")
+			cout << idx.prev_prime(n) << endl;
+		else if (op == "pi")
+			cout << idx.pi(n) << endl;
+		else if (op == "nth_prime")
+			cout << idx.nth_prime(n) << endl;
+		else {
+			cerr << "unknown query " << op << endl;
+			return 1;
+		}
+	}
+	cout << "Index open: " << opened - start << ", queries: " << omp_get_wtime() - opened << endl;
+	return 0;
+}
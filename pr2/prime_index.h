@@ -0,0 +1,191 @@
+/* persistent prime index - mod 30 wheel bitmap with per-block prime counts,
+   written once by prime_index.cpp and opened read-only with mmap:
+
+   header (64 bytes) | bitmap: one byte per 30 numbers | ranks: primes before each block
+
+   bit r of byte k <-> 30k + wheel[r]; a block is 8 words = 64 bytes = 1920 numbers */
+
+#ifndef PR2_PRIME_INDEX_H
+#define PR2_PRIME_INDEX_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rank_select.h"
+
+typedef unsigned long long uLL;
+
+const char index_magic[8] = { 'P', 'R', '2', 'I', 'D', 'X', '1', 0 };
+const uLL numbers_per_word = 240;
+const uLL words_per_block = 8;
+
+const unsigned wheel[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+/* bit of n % 30 in its byte, -1 when n shares a factor with 30 */
+const int wheel_bit[30] = { -1, 0, -1, -1, -1, -1, -1, 1, -1, -1, -1, 2, -1, 3, -1,
+			   -1, -1, 4, -1, 5, -1, -1, -1, 6, -1, -1, -1, -1, -1, 7 };
+
+struct index_header {
+	char magic[8];
+	uLL limit;	// all primes <= limit are in the index
+	uLL words;	// bitmap size in 64-bit words (a multiple of words_per_block)
+	uLL count;	// pi(limit)
+	uLL reserved[4];
+};
+
+/* primes 2, 3 and 5 are not in the bitmap */
+inline uLL small_count(uLL n) {
+	return n < 2 ? 0 : n < 3 ? 1 : n < 5 ? 2 : 3;
+}
+
+/* mask of the wheel bits of a word for the numbers <= n, n inside the word */
+inline uint64_t word_mask_upto(uLL n) {
+	uLL r = n % numbers_per_word;
+	uLL byte = r / 30;
+	uint64_t mask = byte ? (1ULL << (8 * byte)) - 1 : 0;
+	for (int b = 0; b < 8; ++b)
+		if (wheel[b] <= r % 30)
+			mask |= 1ULL << (8 * byte + b);
+	return mask;
+}
+
+struct prime_index {
+	const index_header *header;
+	const uint64_t *bits;
+	const uLL *ranks;
+	size_t length;
+	int fd;
+
+	prime_index() : header(NULL), bits(NULL), ranks(NULL), length(0), fd(-1) {}
+	~prime_index() { close(); }
+
+	/* maps the index file, false when it is missing or not an index */
+	bool open(const char *path) {
+		close();
+		fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(index_header)) {
+			close();
+			return false;
+		}
+		length = st.st_size;
+		void *p = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) {
+			length = 0;
+			close();
+			return false;
+		}
+		header = (const index_header *) p;
+		if (memcmp(header->magic, index_magic, 8) != 0 ||
+		    length != sizeof(index_header) + header->words * 8 + header->words / words_per_block * 8) {
+			close();
+			return false;
+		}
+		bits = (const uint64_t *) (header + 1);
+		ranks = (const uLL *) (bits + header->words);
+		return true;
+	}
+
+	void close() {
+		if (header)
+			munmap((void *) header, length);
+		if (fd >= 0)
+			::close(fd);
+		header = NULL;
+		bits = NULL;
+		ranks = NULL;
+		fd = -1;
+	}
+
+	uLL limit() const { return header->limit; }
+	uLL count() const { return header->count; }
+
+	/* n <= limit() */
+	bool is_prime(uLL n) const {
+		if (n < 7)
+			return n == 2 || n == 3 || n == 5;
+		int b = wheel_bit[n % 30];
+		if (b < 0)
+			return false;
+		return (bits[n / numbers_per_word] >> (8 * (n % numbers_per_word / 30) + b)) & 1;
+	}
+
+	/* number of primes <= n, n <= limit() */
+	uLL pi(uLL n) const {
+		if (n < 7)
+			return small_count(n);
+		uLL w = n / numbers_per_word;
+		uLL block = w / words_per_block;
+		uLL c = 3 + ranks[block] + popcount_words(bits + block * words_per_block, w - block * words_per_block);
+		return c + popcount64(bits[w] & word_mask_upto(n));
+	}
+
+	/* k-th prime (nth_prime(1) = 2), 0 when k > count() */
+	uLL nth_prime(uLL k) const {
+		static const uLL first[4] = { 0, 2, 3, 5 };
+		if (k < 4)
+			return first[k];
+		if (k > header->count)
+			return 0;
+		k -= 3;
+		// last block with less than k primes before it
+		uLL lo = 0, hi = header->words / words_per_block;
+		while (hi - lo > 1) {
+			uLL mid = (lo + hi) / 2;
+			if (ranks[mid] < k)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		k -= ranks[lo];
+		uLL w = lo * words_per_block;
+		for (;; ++w) {
+			uLL c = popcount64(bits[w]);
+			if (c >= k)
+				break;
+			k -= c;
+		}
+		int b = select64(bits[w], (unsigned) (k - 1));
+		return w * numbers_per_word + 30 * (b / 8) + wheel[b % 8];
+	}
+
+	/* smallest prime > n, 0 when there is none up to limit() */
+	uLL next_prime(uLL n) const {
+		if (n < 5)
+			return n < 2 ? 2 : n < 3 ? 3 : 5;
+		if (n >= header->limit)
+			return 0;
+		uLL w = n / numbers_per_word;
+		uint64_t word = bits[w] & ~word_mask_upto(n);
+		while (!word) {
+			if (++w == header->words)
+				return 0;
+			word = bits[w];
+		}
+		int b = __builtin_ctzll(word);
+		uLL p = w * numbers_per_word + 30 * (b / 8) + wheel[b % 8];
+		return p <= header->limit ? p : 0;
+	}
+
+	/* largest prime < n, 0 when n <= 2; n <= limit() + 1 */
+	uLL prev_prime(uLL n) const {
+		if (n <= 7)
+			return n <= 2 ? 0 : n <= 3 ? 2 : n <= 5 ? 3 : 5;
+		uLL w = (n - 1) / numbers_per_word;
+		uint64_t word = bits[w] & word_mask_upto(n - 1);
+		while (!word) {
+			if (w == 0)
+				return 5;
+			word = bits[--w];
+		}
+		int b = 63 - __builtin_clzll(word);
+		return w * numbers_per_word + 30 * (b / 8) + wheel[b % 8];
+	}
+};
+
+#endif
@@ -0,0 +1,87 @@
+/* primes on demand:  for (uLL p : prime_range(lo, hi)) ...   or   for (uLL p : primes()) ...
+   one L1-sized segment is sieved at a time, base primes are added lazily (segment_sieve),
+   so memory does not depend on how far the loop goes (only on sqrt of the current prime) */
+
+#ifndef PR2_PRIME_RANGE_H
+#define PR2_PRIME_RANGE_H
+
+#include <iterator>
+#include <memory>
+
+#include "sieve.h"
+
+const uLL range_segment = 1 << 18;	// 2^17 bits = 16 KB
+
+/* single pass input iterator - copies share the sieve */
+
+struct prime_iterator {
+	typedef std::input_iterator_tag iterator_category;
+	typedef uLL value_type;
+	typedef ptrdiff_t difference_type;
+	typedef const uLL *pointer;
+	typedef const uLL &reference;
+
+	std::shared_ptr<segment_sieve> s;	// NULL at the end
+	size_t word;
+	uint64_t left;		// bits of the word after the current prime
+	uLL value;
+
+	prime_iterator() : word(0), left(0), value(0) {}
+
+	prime_iterator(uLL lo, uLL hi) : s(new segment_sieve(lo, hi, range_segment)), word(0), left(0), value(0) {
+		if (lo <= 2 && hi > 2) {
+			value = 2;
+			if (!s->next_segment())
+				s.reset();
+			else
+				left = s->bits[0];
+		}
+		else if (!s->next_segment())
+			s.reset();
+		else {
+			left = s->bits[0];
+			advance();
+		}
+	}
+
+	void advance() {
+		while (!left) {
+			if (++word == s->bits.size()) {
+				if (!s->next_segment()) {
+					s.reset();
+					return;
+				}
+				word = 0;
+			}
+			left = s->bits[word];
+		}
+		value = s->low + 2 * (word * 64 + __builtin_ctzll(left)) + 1;
+		left &= left - 1;
+	}
+
+	const uLL &operator*() const { return value; }
+	prime_iterator &operator++() { advance(); return *this; }
+	prime_iterator operator++(int) { prime_iterator t = *this; advance(); return t; }
+	bool operator==(const prime_iterator &o) const {
+		return s == o.s && (!s || (word == o.word && left == o.left));
+	}
+	bool operator!=(const prime_iterator &o) const { return !(*this == o); }
+};
+
+/* primes in [lo, hi) */
+
+struct prime_range {
+	uLL lo, hi;
+
+	prime_range(uLL lo_, uLL hi_) : lo(lo_), hi(hi_) {}
+	prime_iterator begin() const { return prime_iterator(lo, hi); }
+	prime_iterator end() const { return prime_iterator(); }
+};
+
+/* all primes from lo on - the loop has to break by itself */
+
+inline prime_range primes(uLL lo = 0) {
+	return prime_range(lo, ~0ULL);
+}
+
+#endif
@@ -0,0 +1,633 @@
+/* prime queries as a service on a Unix socket, so the processes that need them share
+   one table instead of each sieving its own (protocol in prime_client.h)
+
+   backed by the mmap-ed index of prime_index.cpp; above its limit is_prime falls back
+   to Miller-Rabin and count / list to the segmented sieve (ranges up to sieve_range)
+
+   one thread polls the connections, the request lines read from a connection in one go
+   become one batch (at most batch_lines, a list ends it); the pool takes up to
+   batch_jobs batches at a time off the queue and answers them into the connection's
+   output buffer, which the poll thread sends without blocking. A connection with a
+   batch in flight, or with more than out_high bytes not sent, is not read, so its
+   answers stay in order and a client that does not read holds memory, not a thread.
+   A line longer than max_request gets an error and the connection is closed.
+   Latencies (read -> answered) go to log2 histograms per query type, returned by "stats"
+
+   build: g++ -O2 -fopenmp -pthread prime_server.cpp -o prime_server
+   usage: ./prime_server serve socket [primes.idx] [threads]
+          ./prime_server query socket request...        e.g. count 1 1000000
+          ./prime_server bench socket clients requests [depth]
+          ./prime_server check        the answers near 2^64, without a socket    */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <omp.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <random>
+
+#include "sieve.h"
+#include "prime_index.h"
+#include "miller_rabin.h"
+#include "prime_client.h"
+
+using namespace std;
+
+const uLL sieve_range = 1ULL << 34;	// widest count above the index
+const uLL list_range = 1 << 24;		// widest list
+const uLL range_top = ~0ULL - segment_numbers;	// highest end of a range - hi + a segment fits in uLL
+const size_t batch_jobs = 16;
+const size_t batch_lines = 64;		// requests per batch
+const size_t max_request = 4096;	// bytes of one request line
+const size_t out_high = 1 << 20;	// answers not sent yet before the connection is not read
+
+enum query_type { q_is_prime, q_count, q_nth, q_list, q_stats, q_error, query_types };
+const char *const query_names[] = { "is_prime", "count", "nth", "list", "stats", "error" };
+const int hist_buckets = 40;
+
+/* bucket b: latency below 2^b microseconds */
+
+struct latency_histogram {
+	atomic<uLL> bucket[query_types][hist_buckets];
+	atomic<uLL> requests, batches;
+
+	latency_histogram() : requests(0), batches(0) {
+		for (int q = 0; q < query_types; ++q)
+			for (int b = 0; b < hist_buckets; ++b)
+				bucket[q][b] = 0;
+	}
+
+	void add(int q, double seconds) {
+		uLL us = (uLL) (seconds * 1e6);
+		int b = us ? 64 - __builtin_clzll(us) : 0;
+		++bucket[q][b < hist_buckets ? b : hist_buckets - 1];
+	}
+
+	/* upper bound in microseconds of the fraction f of the requests of type q */
+	uLL percentile(int q, double f) const {
+		uLL total = 0, seen = 0;
+		for (int b = 0; b < hist_buckets; ++b)
+			total += bucket[q][b];
+		for (int b = 0; b < hist_buckets; ++b) {
+			seen += bucket[q][b];
+			if (seen && seen >= f * total)
+				return 1ULL << b;
+		}
+		return 0;
+	}
+
+	string report(double uptime) const {
+		ostringstream s;
+		uLL r = requests, bt = batches;
+		s << "requests " << r << ", batches " << bt << " (" << (bt ? (double) r / bt : 0)
+		  << " per batch), uptime " << uptime << " s\n";
+		for (int q = 0; q < query_types; ++q) {
+			uLL n = 0;
+			for (int b = 0; b < hist_buckets; ++b)
+				n += bucket[q][b];
+			if (!n)
+				continue;
+			s << query_names[q] << ": " << n << ", p50 < " << percentile(q, 0.5) << " us, p99 < "
+			  << percentile(q, 0.99) << " us, buckets";
+			int last = hist_buckets - 1;
+			while (!bucket[q][last])
+				--last;
+			for (int b = 0; b <= last; ++b)
+				s << ' ' << bucket[q][b];
+			s << '\n';
+		}
+		s << ".";
+		return s.str();
+	}
+};
+
+/* the answers - the index below its limit, the sieve / Miller-Rabin above it */
+
+struct prime_service {
+	prime_index idx;
+	bool indexed;
+
+	prime_service() : indexed(false) {}
+
+	uLL limit() const { return indexed ? idx.limit() : 0; }
+
+	/* number of primes in [lo, hi] */
+	bool count(uLL lo, uLL hi, uLL &c) const {
+		if (lo > hi) {
+			c = 0;
+			return true;
+		}
+		if (indexed && hi <= limit()) {
+			c = idx.pi(hi) - (lo ? idx.pi(lo - 1) : 0);
+			return true;
+		}
+		if (hi - lo >= sieve_range || hi > range_top)
+			return false;
+		c = count_primes(lo, hi + 1);
+		return true;
+	}
+
+	template <class F> bool list(uLL lo, uLL hi, F f) const {
+		if (lo > hi)
+			return true;
+		if (hi - lo >= list_range || hi > range_top)
+			return false;
+		if (indexed && hi <= limit()) {
+			for (uLL p = lo ? idx.next_prime(lo - 1) : 2; p && p <= hi; p = idx.next_prime(p))
+				f(p);
+			return true;
+		}
+		if (lo <= 2 && hi >= 2)
+			f(2);
+		segment_sieve s(lo, hi + 1);
+		while (s.next_segment())
+			s.each(f);
+		return true;
+	}
+
+	/* one request line -> answer (no newline), the query type for the statistics */
+	int answer(const string &line, string &out, const latency_histogram &h, double uptime) const {
+		istringstream in(line);
+		string op;
+		uLL a = 0, b = 0;
+		in >> op;
+		if (op == "is_prime" && in >> a) {
+			out += (indexed && a <= limit() ? idx.is_prime(a) : is_prime_mr(a)) ? '1' : '0';
+			return q_is_prime;
+		}
+		bool range = (op == "count" || op == "list") && in >> a >> b;
+		if (range && b > range_top) {
+			out += "error: ranges end at " + to_string(range_top) + " at most";
+			return q_error;
+		}
+		if (op == "count" && range) {
+			uLL c;
+			if (!count(a, b, c)) {
+				out += "error: range wider than " + to_string(sieve_range) + " above the index";
+				return q_error;
+			}
+			out += to_string(c);
+			return q_count;
+		}
+		if (op == "nth" && in >> a) {
+			uLL p = indexed ? idx.nth_prime(a) : 0;
+			if (!p) {
+				out += "error: beyond the index";
+				return q_error;
+			}
+			out += to_string(p);
+			return q_nth;
+		}
+		if (op == "list" && range) {
+			size_t start = out.size();
+			bool first = true;
+			auto put = [&](uLL p) {
+				if (!first)
+					out += ' ';
+				first = false;
+				char buf[max_line];
+				out.append(buf, format_line(p, buf) - 1);
+			};
+			if (!list(a, b, put)) {
+				out.resize(start);
+				out += "error: range wider than " + to_string(list_range);
+				return q_error;
+			}
+			return q_list;
+		}
+		if (op == "stats") {
+			out += h.report(uptime);
+			return q_stats;
+		}
+		out += "error: unknown request: " + line;
+		return q_error;
+	}
+};
+
+struct connection {
+	int fd;
+	string in;
+	string out;		// answers not sent yet - appended by the pool, sent by the poll thread
+	mutex out_lock;
+	atomic<bool> busy;	// a batch in the queue or being answered
+	bool closing;		// closed once out is sent
+	connection(int f) : fd(f), busy(false), closing(false) {}
+
+	size_t unsent() {
+		lock_guard<mutex> l(out_lock);
+		return out.size();
+	}
+
+	/* as much of out as the socket takes now, false on an error */
+	bool flush() {
+		lock_guard<mutex> l(out_lock);
+		size_t sent = 0;
+		while (sent < out.size()) {
+			ssize_t w = send(fd, out.data() + sent, out.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (w < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					break;
+				return false;
+			}
+			sent += w;
+		}
+		out.erase(0, sent);
+		return true;
+	}
+};
+
+struct batch {
+	connection *c;
+	vector<string> lines;
+	double received;
+};
+
+struct prime_server {
+	prime_service service;
+	latency_histogram hist;
+	deque<batch> queue;
+	mutex lock;
+	condition_variable ready;
+	bool stopping;
+	int wake[2];		// written by the pool when a connection is free again
+	double started;
+
+	prime_server() : stopping(false), started(omp_get_wtime()) {}
+
+	void worker() {
+		vector<batch> mine;
+		for (;;) {
+			{
+				unique_lock<mutex> l(lock);
+				ready.wait(l, [&] { return stopping || !queue.empty(); });
+				if (stopping)
+					return;
+				while (!queue.empty() && mine.size() < batch_jobs) {
+					mine.push_back(move(queue.front()));
+					queue.pop_front();
+				}
+			}
+			for (size_t j = 0; j < mine.size(); ++j) {
+				batch &bt = mine[j];
+				string out;
+				vector<int> types;
+				for (size_t i = 0; i < bt.lines.size(); ++i) {
+					types.push_back(service.answer(bt.lines[i], out, hist, omp_get_wtime() - started));
+					out += '\n';
+				}
+				{
+					lock_guard<mutex> l(bt.c->out_lock);
+					bt.c->out += out;
+				}
+				double done = omp_get_wtime();
+				for (size_t i = 0; i < types.size(); ++i)
+					hist.add(types[i], done - bt.received);
+				hist.requests += types.size();
+				++hist.batches;
+				bt.c->busy = false;
+				char x = 0;
+				write_all(wake[1], &x, 1);
+			}
+			mine.clear();
+		}
+	}
+
+	/* complete lines of c into a batch, false when there are none; a line that is too
+	   long gets an error and the connection is closed */
+	bool take_lines(connection *c, double now) {
+		batch bt;
+		bt.c = c;
+		bt.received = now;
+		size_t from = 0, eol;
+		while (bt.lines.size() < batch_lines && (eol = c->in.find('\n', from)) != string::npos) {
+			if (eol - from > max_request)
+				break;
+			if (eol > from)
+				bt.lines.push_back(c->in.substr(from, eol - from));
+			from = eol + 1;
+			if (bt.lines.size() && bt.lines.back().compare(0, 4, "list") == 0)
+				break;		// up to list_range numbers of text - one per batch
+		}
+		c->in.erase(0, from);
+		size_t eol_left = c->in.find('\n');
+		if (bt.lines.empty() && (eol_left == string::npos ? c->in.size() : eol_left) > max_request) {
+			lock_guard<mutex> l(c->out_lock);
+			c->out += "error: request longer than " + to_string(max_request) + " bytes\n";
+			c->in.clear();
+			c->closing = true;
+			return false;
+		}
+		if (bt.lines.empty())
+			return false;
+		c->busy = true;
+		lock_guard<mutex> l(lock);
+		queue.push_back(move(bt));
+		ready.notify_one();
+		return true;
+	}
+};
+
+volatile sig_atomic_t interrupted = 0;
+
+void on_signal(int) { interrupted = 1; }
+
+int serve(const char *path, const char *index_path, int threads) {
+	prime_server s;
+	if (index_path) {
+		s.service.indexed = s.service.idx.open(index_path);
+		if (!s.service.indexed) {
+			cerr << "cannot open index " << index_path << endl;
+			return 1;
+		}
+	}
+	int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un a;
+	memset(&a, 0, sizeof(a));
+	a.sun_family = AF_UNIX;
+	strncpy(a.sun_path, path, sizeof(a.sun_path) - 1);
+	unlink(path);
+	if (lfd < 0 || bind(lfd, (sockaddr *) &a, sizeof(a)) != 0 || listen(lfd, 128) != 0 || pipe(s.wake) != 0) {
+		perror(path);
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	vector<thread> pool;
+	for (int i = 0; i < threads; ++i)
+		pool.push_back(thread([&s] { s.worker(); }));
+	cout << "serving " << path << " with " << threads << " threads, index limit " << s.service.limit() << endl;
+
+	vector<connection *> conns;
+	while (!interrupted) {
+		vector<pollfd> fds;
+		pollfd l = { lfd, POLLIN, 0 }, w = { s.wake[0], POLLIN, 0 };
+		fds.push_back(l);
+		fds.push_back(w);
+		vector<connection *> who;
+		double now = omp_get_wtime();
+		for (size_t i = 0; i < conns.size(); ++i) {
+			connection *c = conns[i];
+			if (c->fd < 0)
+				continue;
+			bool lines = c->in.find('\n') != string::npos;
+			if (!c->busy && lines && c->unsent() < out_high)	// lines left from the last read
+				s.take_lines(c, now);
+			lines = c->in.find('\n') != string::npos;
+			size_t unsent = c->unsent();
+			bool readable = !c->busy && !c->closing && unsent < out_high;
+			if (c->closing && !unsent && !c->busy && !lines) {
+				close(c->fd);
+				c->fd = -1;
+				continue;
+			}
+			pollfd p = { c->fd, (short) ((readable ? POLLIN : 0) | (unsent ? POLLOUT : 0)), 0 };
+			if (p.events) {
+				fds.push_back(p);
+				who.push_back(c);
+			}
+		}
+		if (poll(&fds[0], fds.size(), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+		if (fds[1].revents) {
+			char buf[256];
+			if (read(s.wake[0], buf, sizeof(buf)) < 0)
+				perror("wake");
+		}
+		if (fds[0].revents) {
+			int fd = accept(lfd, NULL, NULL);
+			if (fd >= 0)
+				conns.push_back(new connection(fd));
+		}
+		now = omp_get_wtime();
+		for (size_t j = 2; j < fds.size(); ++j) {
+			if (!fds[j].revents)
+				continue;
+			connection *c = who[j - 2];
+			if ((fds[j].revents & POLLOUT) && !c->flush()) {
+				close(c->fd);
+				c->fd = -1;
+				continue;
+			}
+			if (!(fds[j].events & POLLIN) || !(fds[j].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			char buf[1 << 16];
+			ssize_t r = read(c->fd, buf, sizeof(buf));
+			if (r > 0) {
+				c->in.append(buf, r);
+				s.take_lines(c, now);
+			} else if (r == 0)	// the client is done sending - answer what it sent, then close
+				c->closing = true;
+			else if (errno != EINTR && errno != EAGAIN) {
+				close(c->fd);
+				c->fd = -1;
+			}
+		}
+		// closed connections go once nothing of theirs is in flight
+		size_t k = 0;
+		for (size_t i = 0; i < conns.size(); ++i)
+			if (conns[i]->fd < 0 && !conns[i]->busy)
+				delete conns[i];
+			else
+				conns[k++] = conns[i];
+		conns.resize(k);
+	}
+	{
+		lock_guard<mutex> l(s.lock);
+		s.stopping = true;
+	}
+	s.ready.notify_all();
+	for (size_t i = 0; i < pool.size(); ++i)
+		pool[i].join();
+	for (size_t i = 0; i < conns.size(); ++i) {
+		if (conns[i]->fd >= 0)
+			close(conns[i]->fd);
+		delete conns[i];
+	}
+	close(lfd);
+	unlink(path);
+	cout << s.hist.report(omp_get_wtime() - s.started) << endl;
+	return 0;
+}
+
+/* clients threads, each sending requests random queries below limit in rounds of depth
+   pipelined lines; the answers are checked against a local sieve of the same range */
+
+int bench(const char *path, int clients, uLL requests, unsigned depth) {
+	prime_client probe;
+	if (!probe.connect(path)) {
+		perror(path);
+		return 1;
+	}
+	string st;
+	uLL limit = 100000000;
+	cout << "queries below " << limit << ", checked against the local sieve" << endl;
+	vector<uint64_t> flags((limit + 1) / 64 + 1, 0);
+	vector<uLL> pi_words(flags.size() + 1, 0);
+	flags[0] |= 1ULL << 2;
+	segment_sieve sv(0, limit + 1);
+	while (sv.next_segment())
+		sv.each([&](uLL p) { flags[p / 64] |= 1ULL << (p % 64); });
+	for (size_t i = 0; i < flags.size(); ++i)
+		pi_words[i + 1] = pi_words[i] + __builtin_popcountll(flags[i]);
+	auto pi = [&](uLL n) {	// primes <= n
+		uint64_t m = n % 64 == 63 ? ~0ULL : (2ULL << (n % 64)) - 1;
+		return pi_words[n / 64] + __builtin_popcountll(flags[n / 64] & m);
+	};
+
+	atomic<uLL> wrong(0), lost(0);
+	vector<double> worst(clients, 0);
+	double start = omp_get_wtime();
+	vector<thread> t;
+	for (int c = 0; c < clients; ++c)
+		t.push_back(thread([&, c] {
+			prime_client pc;
+			if (!pc.connect(path)) {
+				lost += requests;
+				return;
+			}
+			mt19937_64 rng(c + 1);
+			vector<uLL> expect(depth);
+			for (uLL done = 0; done < requests; done += depth) {
+				double sent = omp_get_wtime();
+				for (unsigned i = 0; i < depth; ++i) {
+					uLL n = rng() % limit, w = rng() % 1000000;
+					switch (rng() % 3) {
+					case 0:
+						pc.send("is_prime " + to_string(n));
+						expect[i] = flags[n / 64] >> (n % 64) & 1;
+						break;
+					case 1:
+						if (n + w > limit)
+							w = limit - n;
+						pc.send("count " + to_string(n) + " " + to_string(n + w));
+						expect[i] = pi(n + w) - (n ? pi(n - 1) : 0);
+						break;
+					default:
+						uLL k = n % pi(limit) + 1;
+						pc.send("nth " + to_string(k));
+						uLL lo = 0, hi = limit;	// smallest p with pi(p) >= k
+						while (lo < hi) {
+							uLL mid = (lo + hi) / 2;
+							if (pi(mid) >= k)
+								hi = mid;
+							else
+								lo = mid + 1;
+						}
+						expect[i] = lo;
+					}
+				}
+				for (unsigned i = 0; i < depth; ++i) {
+					string a;
+					if (!pc.line(a)) {
+						lost += depth - i;
+						return;
+					}
+					if (strtoull(a.c_str(), NULL, 10) != expect[i] || a.compare(0, 5, "error") == 0)
+						++wrong;
+				}
+				double took = omp_get_wtime() - sent;
+				if (took > worst[c])
+					worst[c] = took;
+			}
+		}));
+	for (int c = 0; c < clients; ++c)
+		t[c].join();
+	double stop = omp_get_wtime();
+	double w = 0;
+	for (int c = 0; c < clients; ++c)
+		w = worst[c] > w ? worst[c] : w;
+	uLL total = (uLL) clients * ((requests + depth - 1) / depth * depth);
+	cout << total << " requests from " << clients << " clients (depth " << depth << "): " << stop - start
+	     << " s, " << total / (stop - start) << " requests/s, slowest round " << w * 1e3 << " ms" << endl;
+	cout << "wrong " << wrong << ", lost " << lost << endl;
+	probe.send("stats");
+	while (probe.line(st) && st != ".")
+		cout << "  " << st << endl;
+	return wrong || lost ? 1 : 0;
+}
+
+/* answers at the top of uLL, no socket and no index: ranges ending above range_top
+   are refused, the ones up to it agree with Miller-Rabin (half a minute - a sieve up
+   there needs the base primes up to 2^32) */
+
+int check() {
+	prime_service s;
+	latency_histogram h;
+	int wrong = 0;
+	auto expect = [&](const string &line, const string &want) {	// want "" - an error
+		string out;
+		s.answer(line, out, h, 0);
+		bool ok = want.empty() ? out.compare(0, 6, "error:") == 0 : out == want;
+		cout << line << " -> " << out.substr(0, 60) << (out.size() > 60 ? "..." : "") << (ok ? "" : "   WRONG") << endl;
+		wrong += !ok;
+	};
+	const uLL top = ~0ULL, lo = range_top - 1000;
+	string listed;
+	uLL n = 0;
+	for (uLL m = lo; m <= range_top; ++m)
+		if (is_prime_mr(m))
+			listed += (n++ ? " " : "") + to_string(m);
+	string range = to_string(lo) + " " + to_string(range_top);
+	expect("count " + range, to_string(n));
+	expect("list " + range, listed);
+	expect("count 18446744073709551000 18446744073709551614", "");
+	expect("list 18446744073709551000 18446744073709551614", "");
+	expect("count " + to_string(top - 10) + " " + to_string(top), "");
+	expect("is_prime " + to_string(top - 58), "1");
+	expect("is_prime " + to_string(top), "0");
+	cout << (wrong ? "FAILED" : "ok") << endl;
+	return wrong ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc == 2 && string(argv[1]) == "check")
+		return check();
+	string mode = argc > 2 ? argv[1] : "";
+	if (mode == "serve")
+		return serve(argv[2], argc > 3 ? argv[3] : NULL, argc > 4 ? atoi(argv[4]) : omp_get_max_threads());
+	if (mode == "query" && argc > 3) {
+		prime_client c;
+		if (!c.connect(argv[2])) {
+			perror(argv[2]);
+			return 1;
+		}
+		string request = argv[3];
+		for (int i = 4; i < argc; ++i)
+			request += string(" ") + argv[i];
+		string a;
+		c.send(request);
+		while (c.line(a)) {
+			cout << a << endl;
+			if (request != "stats" || a == ".")
+				break;
+		}
+		return 0;
+	}
+	if (mode == "bench" && argc > 4)
+		return bench(argv[2], atoi(argv[3]), strtoull(argv[4], NULL, 10), argc > 5 ? atoi(argv[5]) : 16);
+	cout << "usage: " << argv[0] << " serve socket [primes.idx] [threads]" << endl;
+	cout << "       " << argv[0] << " query socket request..." << endl;
+	cout << "       " << argv[0] << " bench socket clients requests [depth]" << endl;
+	cout << "       " << argv[0] << " check" << endl;
+	return 1;
+}
@@ -0,0 +1,143 @@
+/* binary prime streams (prime_stream.h) - writing, converting and reading back
+
+   build: g++ -O2 -fopenmp prime_stream.cpp -o prime_stream
+   usage: ./prime_stream generate limit out.bin     primes <= limit, segmented sieve
+          ./prime_stream encode in.txt out.bin      text (one prime per line) -> binary
+          ./prime_stream decode in.bin out.txt      binary -> text
+          ./prime_stream verify in.bin              checksums, order, read speed
+          ./prime_stream from in.bin n [k]          k primes from the first one >= n */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+
+#include "prime_range.h"
+#include "prime_writer.h"
+#include "prime_stream.h"
+
+using namespace std;
+
+bool generate(uLL limit, const char *path) {
+	prime_stream_writer w;
+	if (!w.open(path))
+		return false;
+	double start = omp_get_wtime();
+	for (uLL p : prime_range(0, limit + 1))
+		w.put(p);
+	bool ok = w.close();
+	cout << w.count << " primes, " << w.offset << " bytes of blocks: " << omp_get_wtime() - start << endl;
+	return ok;
+}
+
+bool encode(const char *in, const char *out) {
+	ifstream f(in);
+	prime_stream_writer w;
+	if (!f || !w.open(out))
+		return false;
+	uLL p, prev = 0;
+	while (f >> p) {
+		if (p <= prev && w.count > 0) {
+			cerr << "not increasing: " << prev << ", " << p << endl;
+			return false;
+		}
+		if (w.count > 0 && (p - prev) % 2 && !(prev == 2 && p == 3)) {	// halved gaps only
+			cerr << "odd gap: " << prev << ", " << p << endl;
+			return false;
+		}
+		w.put(p);
+		prev = p;
+	}
+	return w.close();
+}
+
+bool decode(const char *in, const char *out) {
+	prime_stream_reader r;
+	if (!r.open(in))
+		return false;
+	int fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+	bool ok;
+	{
+		prime_writer w(fd);
+		for (prime_stream_reader::iterator it = r.begin(), e = r.end(); it != e; ++it)
+			w.put(*it);
+		ok = w.flush();
+	}
+	ok = close(fd) == 0 && ok;
+	return ok && !r.corrupt;
+}
+
+/* all blocks decoded, checked and timed - iterator and bulk decoding */
+
+bool verify(const char *path) {
+	prime_stream_reader r;
+	if (!r.open(path))
+		return false;
+	double start = omp_get_wtime();
+	uLL n = 0, prev = 0, sum = 0;
+	bool sorted = true;
+	for (prime_stream_reader::iterator it = r.begin(), e = r.end(); it != e; ++it) {
+		sorted = sorted && *it > prev;
+		prev = *it;
+		sum += *it;
+		++n;
+	}
+	double stop = omp_get_wtime();
+	cout << "Iterator: " << n << " primes in " << stop - start << " s, "
+	     << n / (stop - start) / 1e6 << " M primes/s" << endl;
+
+	r.verify = false;
+	vector<uLL> buf(stream_block_primes);
+	uLL sum2 = 0;
+	start = omp_get_wtime();
+	for (uLL b = 0; b < r.blocks(); ++b) {
+		size_t c = r.decode_block(b, &buf[0]);
+		for (size_t i = 0; i < c; ++i)
+			sum2 += buf[i];
+	}
+	stop = omp_get_wtime();
+	cout << "Blocks (no CRC): " << (stop - start) << " s, " << n / (stop - start) / 1e6 << " M primes/s" << endl;
+
+	bool ok = !r.corrupt && sorted && n == r.count() && sum == sum2;
+	cout << r.count() << " primes, " << r.blocks() << " blocks, " << r.length << " bytes: "
+	     << (ok ? "ok" : "CORRUPT") << endl;
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	string op = argc > 1 ? argv[1] : "";
+	bool ok;
+	if (op == "generate" && argc == 4)
+		ok = generate(strtoull(argv[2], NULL, 10), argv[3]);
+	else if (op == "encode" && argc == 4)
+		ok = encode(argv[2], argv[3]);
+	else if (op == "decode" && argc == 4)
+		ok = decode(argv[2], argv[3]);
+	else if (op == "verify" && argc == 3)
+		ok = verify(argv[2]);
+	else if (op == "from" && argc >= 4) {
+		prime_stream_reader r;
+		if (!r.open(argv[2])) {
+			cerr << argv[2] << ": missing or not a prime stream" << endl;
+			return 1;
+		}
+		uLL k = argc > 4 ? strtoull(argv[4], NULL, 10) : 10;
+		prime_stream_reader::iterator it = r.seek(strtoull(argv[3], NULL, 10)), e = r.end();
+		for (; k > 0 && it != e; ++it, --k)
+			cout << *it << endl;
+		ok = !r.corrupt;
+	}
+	else {
+		cout << "usage: " << argv[0] << " generate limit out.bin | encode in.txt out.bin |" << endl;
+		cout << "       decode in.bin out.txt | verify in.bin | from in.bin n [k]" << endl;
+		return 1;
+	}
+	if (!ok)
+		cerr << op << " failed" << endl;
+	return ok ? 0 : 1;
+}
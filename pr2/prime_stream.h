@@ -0,0 +1,381 @@
+/* binary prime stream - primes stored as halved gaps in varints, in blocks with
+   a CRC32C each and an index at the end of the file for seeking:
+
+   "PR2PRM2\0" | block ... block | index entry per block | trailer
+   block:  block_header, payload - varint (p - prev) / 2 for every prime after the first
+           (the gap 2 -> 3 is written as 0); the CRC covers the header (its crc field
+           as 0) and the payload
+   varint: 7 bits per byte, low bits first, high bit set = more bytes follow */
+
+#ifndef PR2_PRIME_STREAM_H
+#define PR2_PRIME_STREAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <iterator>
+
+#include "prime_writer.h"
+
+typedef unsigned long long uLL;
+
+const char stream_magic[8] = { 'P', 'R', '2', 'P', 'R', 'M', '2', 0 };
+const unsigned stream_block_primes = 1 << 16;
+
+struct block_header {
+	uLL first;		// first prime of the block
+	uint32_t count;		// primes in the block
+	uint32_t bytes;		// payload size
+	uint32_t crc;		// CRC32C of the payload
+	uint32_t reserved;
+};
+
+struct index_entry {
+	uLL first;
+	uLL offset;		// of the block header
+	uLL rank;		// primes before the block
+};
+
+struct stream_trailer {
+	uLL index_offset;
+	uLL blocks;
+	uLL count;
+	char magic[8];
+};
+
+/* CRC32C (Castagnoli) - SSE4.2 instruction or a table */
+
+__attribute__((target("sse4.2")))
+inline uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len) {
+	uint64_t c = ~crc;
+	for (; len >= 8; p += 8, len -= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		c = __builtin_ia32_crc32di(c, v);
+	}
+	uint32_t c32 = (uint32_t) c;
+	for (; len; ++p, --len)
+		c32 = __builtin_ia32_crc32qi(c32, *p);
+	return ~c32;
+}
+
+inline uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len) {
+	static uint32_t table[256];
+	static bool ready = false;
+	if (!ready) {
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+				c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+			table[i] = c;
+		}
+		ready = true;
+	}
+	crc = ~crc;
+	for (; len; ++p, --len)
+		crc = table[(crc ^ *p) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+inline uint32_t crc32c(const void *data, size_t len, uint32_t crc = 0) {
+	static int hw = -1;
+	if (hw < 0) {
+		__builtin_cpu_init();
+		hw = __builtin_cpu_supports("sse4.2");
+	}
+	const unsigned char *p = (const unsigned char *) data;
+	return hw ? crc32c_hw(crc, p, len) : crc32c_sw(crc, p, len);
+}
+
+/* CRC of a block: the header with crc = 0, then the payload */
+
+inline uint32_t block_crc(const block_header &h, const void *payload) {
+	block_header c = h;
+	c.crc = 0;
+	return crc32c(payload, h.bytes, crc32c(&c, sizeof(c)));
+}
+
+/* varint of the halved gap */
+
+inline unsigned char *put_gap(unsigned char *p, uLL gap) {
+	uLL v = gap == 1 ? 0 : gap / 2;
+	while (v >= 128) {
+		*p++ = (unsigned char) (v | 128);
+		v >>= 7;
+	}
+	*p++ = (unsigned char) v;
+	return p;
+}
+
+inline const unsigned char *get_gap(const unsigned char *p, uLL &gap) {
+	uLL v = *p++;
+	if (v >= 128) {
+		v &= 127;
+		int shift = 7;
+		uLL b;
+		do {
+			b = *p++;
+			v |= (b & 127) << shift;
+			shift += 7;
+		} while (b >= 128);
+	}
+	gap = v ? 2 * v : 1;
+	return p;
+}
+
+/* writes increasing primes into a stream file */
+
+struct prime_stream_writer {
+	int fd;
+	uLL offset;
+	uLL count;
+	uLL prev;
+	block_header block;
+	std::vector<unsigned char> payload;
+	unsigned char *end;
+	std::vector<index_entry> index;
+	bool ok;
+
+	prime_stream_writer() : fd(-1), ok(false) {}
+	~prime_stream_writer() { close(); }
+
+	bool open(const char *path) {
+		fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			return false;
+		ok = write_all(fd, stream_magic, 8);
+		offset = 8;
+		count = 0;
+		block.count = 0;
+		payload.resize(stream_block_primes * 10);
+		end = &payload[0];
+		index.clear();
+		return ok;
+	}
+
+	void put(uLL p) {
+		if (block.count == 0) {
+			block.first = p;
+			end = &payload[0];
+		}
+		else
+			end = put_gap(end, p - prev);
+		prev = p;
+		++count;
+		if (++block.count == stream_block_primes)
+			flush_block();
+	}
+
+	void flush_block() {
+		if (block.count == 0)
+			return;
+		block.bytes = (uint32_t) (end - &payload[0]);
+		block.reserved = 0;
+		block.crc = block_crc(block, &payload[0]);
+		index_entry e = { block.first, offset, count - block.count };
+		index.push_back(e);
+		ok = write_all(fd, (const char *) &block, sizeof(block)) && ok;
+		ok = write_all(fd, (const char *) &payload[0], block.bytes) && ok;
+		offset += sizeof(block) + block.bytes;
+		block.count = 0;
+	}
+
+	/* last block, index and trailer */
+	bool close() {
+		if (fd < 0)
+			return ok;
+		flush_block();
+		stream_trailer t = { offset, index.size(), count, { 0 } };
+		memcpy(t.magic, stream_magic, 8);
+		if (!index.empty())
+			ok = write_all(fd, (const char *) &index[0], index.size() * sizeof(index_entry)) && ok;
+		ok = write_all(fd, (const char *) &t, sizeof(t)) && ok;
+		ok = ::close(fd) == 0 && ok;
+		fd = -1;
+		return ok;
+	}
+};
+
+/* read-only view of a stream file (mmap) with a forward iterator over the primes */
+
+struct prime_stream_reader {
+	const unsigned char *data;
+	size_t length;
+	const index_entry *index;
+	stream_trailer trailer;
+	bool verify;		// check the CRC of every block the iterators enter
+	bool corrupt;		// set when a check failed
+
+	prime_stream_reader() : data(NULL), length(0), index(NULL), verify(true), corrupt(false) {
+		memset(&trailer, 0, sizeof(trailer));
+	}
+	~prime_stream_reader() { close(); }
+
+	bool open(const char *path) {
+		close();
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (size_t) st.st_size < 8 + sizeof(stream_trailer)) {
+			::close(fd);
+			return false;
+		}
+		length = st.st_size;
+		void *p = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (p == MAP_FAILED)
+			return false;
+		data = (const unsigned char *) p;
+		madvise(p, length, MADV_SEQUENTIAL);
+		memcpy(&trailer, data + length - sizeof(trailer), sizeof(trailer));
+		if (memcmp(data, stream_magic, 8) != 0 || memcmp(trailer.magic, stream_magic, 8) != 0 ||
+		    trailer.index_offset < 8 || trailer.index_offset > length || trailer.blocks > length / sizeof(index_entry) ||
+		    trailer.index_offset + trailer.blocks * sizeof(index_entry) + sizeof(trailer) != length) {
+			close();
+			return false;
+		}
+		index = (const index_entry *) (data + trailer.index_offset);
+		return true;
+	}
+
+	/* a reader that is not open has no blocks, so begin() == end() and seek() is end() */
+	void close() {
+		if (data)
+			munmap((void *) data, length);
+		data = NULL;
+		length = 0;
+		index = NULL;
+		memset(&trailer, 0, sizeof(trailer));
+	}
+
+	bool is_open() const { return data != NULL; }
+
+	uLL count() const { return trailer.count; }
+	uLL blocks() const { return trailer.blocks; }
+
+	const block_header *header(uLL b) const {
+		return (const block_header *) (data + index[b].offset);
+	}
+
+	/* header and payload of block b inside the blocks area - checked before header(b)
+	   is read, with or without verify */
+	bool in_bounds(uLL b) const {
+		uLL o = index[b].offset, end = trailer.index_offset;
+		if (o < 8 || o > end || end - o < sizeof(block_header))
+			return false;
+		const block_header *h = header(b);
+		return h->count >= 1 && h->count <= stream_block_primes && h->bytes <= end - o - sizeof(block_header);
+	}
+
+	bool check_block(uLL b) const {
+		if (!in_bounds(b))
+			return false;
+		const block_header *h = header(b);
+		return block_crc(*h, h + 1) == h->crc;
+	}
+
+	/* all primes of block b into out, returns their number (0 for a corrupt block) */
+	size_t decode_block(uLL b, uLL *out) {
+		if (!(verify ? check_block(b) : in_bounds(b))) {
+			corrupt = true;
+			return 0;
+		}
+		const block_header *h = header(b);
+		const unsigned char *p = (const unsigned char *) (h + 1), *end = p + h->bytes;
+		uLL v = h->first, gap;
+		out[0] = v;
+		for (uint32_t i = 1; i < h->count; ++i) {
+			if (p >= end) {		// fewer gaps than count says
+				corrupt = true;
+				return i;
+			}
+			p = get_gap(p, gap);
+			v += gap;
+			out[i] = v;
+		}
+		return h->count;
+	}
+
+	struct iterator {
+		typedef std::forward_iterator_tag iterator_category;
+		typedef uLL value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const uLL *pointer;
+		typedef const uLL &reference;
+
+		prime_stream_reader *r;
+		uLL block;		// r->blocks() at the end
+		uint32_t left;		// primes of the block after the current one
+		const unsigned char *p, *end;	// next gap, end of the payload
+		uLL value;
+
+		iterator() : r(NULL), block(0), left(0), p(NULL), end(NULL), value(0) {}
+		iterator(prime_stream_reader *r_, uLL b) : r(r_), left(0), p(NULL), end(NULL), value(0) { enter(b); }
+
+		void enter(uLL b) {
+			block = b;
+			while (block < r->blocks() && !(r->verify ? r->check_block(block) : r->in_bounds(block))) {
+				r->corrupt = true;
+				block = r->blocks();
+			}
+			if (block >= r->blocks())
+				return;
+			const block_header *h = r->header(block);
+			value = h->first;
+			left = h->count - 1;
+			p = (const unsigned char *) (h + 1);
+			end = p + h->bytes;
+		}
+
+		const uLL &operator*() const { return value; }
+		iterator &operator++() {
+			if (left && p >= end) {	// fewer gaps than count says
+				r->corrupt = true;
+				block = r->blocks();
+			}
+			else if (left) {
+				uLL gap;
+				p = get_gap(p, gap);
+				value += gap;
+				--left;
+			}
+			else
+				enter(block + 1);
+			return *this;
+		}
+		iterator operator++(int) { iterator t = *this; ++*this; return t; }
+		bool operator==(const iterator &o) const {
+			return block == o.block && (block >= r->blocks() || left == o.left);
+		}
+		bool operator!=(const iterator &o) const { return !(*this == o); }
+	};
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { iterator e; e.r = this; e.block = blocks(); return e; }
+
+	/* iterator at the first prime >= n: binary search of the index, then a block scan */
+	iterator seek(uLL n) {
+		if (!data)
+			return end();
+		uLL lo = 0, hi = blocks();
+		while (hi - lo > 1) {
+			uLL mid = (lo + hi) / 2;
+			if (index[mid].first <= n)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		iterator it(this, lo);
+		iterator e = end();
+		while (it != e && *it < n)
+			++it;
+		return it;
+	}
+};
+
+#endif
@@ -0,0 +1,176 @@
+/* compile-time tables: the primes up to L with their flags, inverses and divisibility
+   limits (for trial_division.h), and the wheels mod 2*3*5..; built by constexpr code,
+   so a program that needs the primes below sqrt(N) reads them from the binary instead
+   of sieving them at startup (genDividers(), generate_primes())
+
+   small_prime_table<46341>::primes   - all primes p with p*p < 2^31 (int range)
+   small_prime_table<65536>::primes   - all primes up to sqrt(2^32)
+   wheel210                           - residues mod 2*3*5*7                   */
+
+#ifndef PR2_PRIME_TABLES_H
+#define PR2_PRIME_TABLES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+
+#include "trial_division.h"
+
+/* floor(sqrt(n)) at compile time */
+
+constexpr uint64_t ct_isqrt(uint64_t n) {
+	uint64_t r = 0;
+	for (uint64_t b = 1ULL << 31; b; b >>= 1)
+		if ((r + b) * (r + b) <= n)
+			r += b;
+	return r;
+}
+
+/* flags[n] for n <= L */
+
+template <uint32_t L> constexpr std::array<bool, L + 1> ct_flags() {
+	std::array<bool, L + 1> f{};
+	for (uint32_t i = 2; i <= L; ++i)
+		f[i] = true;
+	for (uint32_t i = 2; (uint64_t) i * i <= L; ++i)
+		if (f[i])
+			for (uint32_t j = i * i; j <= L; j += i)
+				f[j] = false;
+	return f;
+}
+
+template <size_t M> constexpr size_t ct_count(const std::array<bool, M> &f) {
+	size_t c = 0;
+	for (size_t i = 0; i < M; ++i)
+		c += f[i];
+	return c;
+}
+
+template <uint32_t L> struct small_prime_table {
+	static constexpr uint32_t limit = L;
+	static constexpr std::array<bool, L + 1> flags = ct_flags<L>();
+	static constexpr size_t count = ct_count(flags);
+
+	static constexpr std::array<uint32_t, count> make_primes() {
+		std::array<uint32_t, count> p{};
+		size_t k = 0;
+		for (uint32_t i = 2; i <= L; ++i)
+			if (flags[i])
+				p[k++] = i;
+		return p;
+	}
+	static constexpr std::array<uint32_t, count> primes = make_primes();
+
+	/* for odd p (entry 0, the 2, is unused): p^-1 mod 2^32 / 2^64 and the limits -
+	   p divides n <=> n * inv <= lim */
+	static constexpr std::array<uint32_t, count> make_inv32() {
+		std::array<uint32_t, count> a{};
+		for (size_t i = 1; i < count; ++i)
+			a[i] = inverse32(primes[i]);
+		return a;
+	}
+	static constexpr std::array<uint32_t, count> make_lim32() {
+		std::array<uint32_t, count> a{};
+		for (size_t i = 1; i < count; ++i)
+			a[i] = 0xffffffffu / primes[i];
+		return a;
+	}
+	static constexpr std::array<uint64_t, count> make_inv64() {
+		std::array<uint64_t, count> a{};
+		for (size_t i = 1; i < count; ++i)
+			a[i] = inverse64(primes[i]);
+		return a;
+	}
+	static constexpr std::array<uint64_t, count> make_lim64() {
+		std::array<uint64_t, count> a{};
+		for (size_t i = 1; i < count; ++i)
+			a[i] = ~0ULL / primes[i];
+		return a;
+	}
+	static constexpr std::array<uint32_t, count> inv32 = make_inv32();
+	static constexpr std::array<uint32_t, count> lim32 = make_lim32();
+	static constexpr std::array<uint64_t, count> inv64 = make_inv64();
+	static constexpr std::array<uint64_t, count> lim64 = make_lim64();
+
+	/* trial division with the constant tables, n < (L + 1)^2 */
+	static bool is_prime(uint64_t n) {
+		if (n <= L)
+			return flags[n];
+		if (!(n & 1))
+			return false;
+		for (size_t k = 1; k < count && (uint64_t) primes[k] * primes[k] <= n; ++k)
+			if (n * inv64[k] <= lim64[k])
+				return false;
+		return true;
+	}
+
+	/* the odd primes up to num for the kernels of trial_division.h - the constant
+	   arrays themselves, nothing is computed or copied */
+	static divisor_view divisors(uint32_t num) {
+		size_t n = 1;
+		while (n < count && primes[n] <= num)
+			++n;
+		divisor_view d = { &primes[1], &inv32[1], &lim32[1], &inv64[1], &lim64[1], n - 1 };
+		return d;
+	}
+};
+
+/* wheel of the first K primes: modulus 2*3*5.., the residues prime to it and the gaps
+   between them (gaps[i] leads from residues[i] to the next one, wrapping around) */
+
+template <unsigned K> struct wheel_table {
+	static constexpr uint32_t make_modulus() {
+		uint32_t m = 1;
+		for (unsigned i = 0; i < K; ++i)
+			m *= small_prime_table<64>::primes[i];
+		return m;
+	}
+	static constexpr uint32_t modulus = make_modulus();
+
+	static constexpr bool coprime(uint32_t r) {
+		for (unsigned i = 0; i < K; ++i)
+			if (r % small_prime_table<64>::primes[i] == 0)
+				return false;
+		return true;
+	}
+	static constexpr size_t make_count() {
+		size_t c = 0;
+		for (uint32_t r = 1; r < modulus; ++r)
+			c += coprime(r);
+		return c;
+	}
+	static constexpr size_t count = make_count();
+
+	static constexpr std::array<uint32_t, count> make_residues() {
+		std::array<uint32_t, count> a{};
+		size_t k = 0;
+		for (uint32_t r = 1; r < modulus; ++r)
+			if (coprime(r))
+				a[k++] = r;
+		return a;
+	}
+	static constexpr std::array<uint32_t, count> residues = make_residues();
+
+	static constexpr std::array<uint8_t, count> make_gaps() {
+		std::array<uint8_t, count> a{};
+		for (size_t i = 0; i < count; ++i)
+			a[i] = (uint8_t) (i + 1 < count ? residues[i + 1] - residues[i] : modulus + residues[0] - residues[i]);
+		return a;
+	}
+	static constexpr std::array<uint8_t, count> gaps = make_gaps();
+
+	/* index of r in residues, -1 when r is not prime to the modulus */
+	static constexpr std::array<int16_t, modulus> make_index() {
+		std::array<int16_t, modulus> a{};
+		for (uint32_t r = 0; r < modulus; ++r)
+			a[r] = -1;
+		for (size_t i = 0; i < count; ++i)
+			a[residues[i]] = (int16_t) i;
+		return a;
+	}
+	static constexpr std::array<int16_t, modulus> index = make_index();
+};
+
+typedef wheel_table<4> wheel210;	// divide() in methods.h
+
+#endif
@@ -0,0 +1,185 @@
+/* fast text output of primes - digit pairs instead of ostream formatting, big buffers
+   instead of a flush per line (endl), segments formatted in parallel and written in order */
+
+#ifndef PR2_PRIME_WRITER_H
+#define PR2_PRIME_WRITER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <omp.h>
+#include <vector>
+#include <ostream>
+
+typedef unsigned long long uLL;
+
+const char digit_pairs[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+const size_t max_line = 21;	// 20 digits + '\n'
+
+/* decimal n followed by '\n', returns the number of chars written */
+
+inline size_t format_line(uLL n, char *out) {
+	char tmp[max_line];
+	char *p = tmp + max_line;
+	*--p = '\n';
+	while (n >= 100) {
+		unsigned r = (unsigned) (n % 100);
+		n /= 100;
+		p -= 2;
+		memcpy(p, digit_pairs + 2 * r, 2);
+	}
+	if (n >= 10) {
+		p -= 2;
+		memcpy(p, digit_pairs + 2 * n, 2);
+	}
+	else
+		*--p = (char) ('0' + n);
+	size_t len = tmp + max_line - p;
+	memcpy(out, p, len);
+	return len;
+}
+
+/* write(2) until everything is out */
+
+inline bool write_all(int fd, const char *buf, size_t len) {
+	while (len > 0) {
+		ssize_t w = write(fd, buf, len);
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		buf += w;
+		len -= w;
+	}
+	return true;
+}
+
+inline bool pwrite_all(int fd, const char *buf, size_t len, off_t offset) {
+	while (len > 0) {
+		ssize_t w = pwrite(fd, buf, len, offset);
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		buf += w;
+		len -= w;
+		offset += w;
+	}
+	return true;
+}
+
+/* one number per line into a file descriptor through a reusable buffer */
+
+struct prime_writer {
+	int fd;
+	std::vector<char> buf;
+	size_t used;
+	bool ok;
+
+	prime_writer(int fd_, size_t size = 1 << 22) : fd(fd_), buf(size), used(0), ok(true) {}
+	~prime_writer() { flush(); }
+
+	void put(uLL n) {
+		if (used + max_line > buf.size())
+			flush();
+		used += format_line(n, &buf[used]);
+	}
+
+	/* already formatted text */
+	void put(const char *text, size_t len) {
+		if (used + len > buf.size())
+			flush();
+		if (len > buf.size())
+			ok = write_all(fd, text, len) && ok;
+		else {
+			memcpy(&buf[used], text, len);
+			used += len;
+		}
+	}
+
+	bool flush() {
+		if (used)
+			ok = write_all(fd, &buf[0], used) && ok;
+		used = 0;
+		return ok;
+	}
+};
+
+/* formats the i in [lo, hi) with flags[i] == value, returns the length */
+
+inline size_t format_flagged(const bool *flags, uLL lo, uLL hi, bool value, std::vector<char> &out) {
+	if (out.size() < (hi - lo) * max_line)
+		out.resize((hi - lo) * max_line);
+	char *p = &out[0];
+	for (uLL i = lo; i < hi; ++i)
+		if (flags[i] == value)
+			p += format_line(i, p);
+	return p - &out[0];
+}
+
+const uLL write_segment = 1 << 16;	// numbers formatted by one thread at a time
+
+/* every i < count with flags[i] == value, one per line - rounds of one segment per
+   thread, the round is written in order */
+
+inline void write_flagged(std::ostream &f, const bool *flags, uLL count, bool value) {
+	int threads = omp_get_max_threads();
+	std::vector<std::vector<char> > bufs(threads);
+	std::vector<size_t> lens(threads);
+	for (uLL low = 0; low < count; low += threads * write_segment) {
+		int t;
+#pragma omp parallel for schedule(static, 1)
+		for (t = 0; t < threads; ++t) {
+			uLL lo = low + t * write_segment;
+			uLL hi = lo + write_segment < count ? lo + write_segment : count;
+			lens[t] = lo < count ? format_flagged(flags, lo, hi, value, bufs[t]) : 0;
+		}
+		for (t = 0; t < threads; ++t)
+			if (lens[t])
+				f.write(&bufs[t][0], lens[t]);
+	}
+}
+
+/* the same into a file descriptor from offset on: the formatted segments get their
+   offsets from prefix sums and are written with pwrite in parallel; returns the end offset */
+
+inline off_t pwrite_flagged(int fd, off_t offset, const bool *flags, uLL count, bool value) {
+	int threads = omp_get_max_threads();
+	std::vector<std::vector<char> > bufs(threads);
+	std::vector<size_t> lens(threads);
+	std::vector<off_t> offsets(threads + 1);
+	bool ok = true;
+	for (uLL low = 0; low < count; low += threads * write_segment) {
+		int t;
+#pragma omp parallel
+		{
+#pragma omp for schedule(static, 1)
+			for (t = 0; t < threads; ++t) {
+				uLL lo = low + t * write_segment;
+				uLL hi = lo + write_segment < count ? lo + write_segment : count;
+				lens[t] = lo < count ? format_flagged(flags, lo, hi, value, bufs[t]) : 0;
+			}
+#pragma omp single
+			{
+				offsets[0] = offset;
+				for (int i = 0; i < threads; ++i)
+					offsets[i + 1] = offsets[i] + lens[i];
+			}
+#pragma omp for schedule(static, 1) reduction(&&:ok)
+			for (t = 0; t < threads; ++t)
+				if (lens[t])
+					ok = pwrite_all(fd, &bufs[t][0], lens[t], offsets[t]) && ok;
+		}
+		offset = offsets[threads];
+	}
+	return ok ? offset : -1;
+}
+
+#endif
@@ -0,0 +1,133 @@
+/* rank / select over the odd-only sieve bitmap (rank_select.h): pi(x) = 1 + rank and
+   the n-th prime = select, checked against linear scans, timed against them and
+   against counting a bool table entry by entry
+
+   build: g++ -O2 -fopenmp rank_select.cpp -o rank_select
+   usage: ./rank_select [limit] [queries] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <random>
+#include <iostream>
+
+#include "sieve.h"
+#include "rank_select.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+	uLL limit = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000000;
+	int queries = argc > 2 ? atoi(argv[2]) : 1000000;
+
+	// bit i <-> 2i + 1, the segments of segment_sieve one after another
+	uLL nbits = limit / 2 + 1;
+	vector<uint64_t> bits((nbits + 63) / 64 + 1, 0);
+	double start = omp_get_wtime();
+	long long segs = (long long) (limit / segment_numbers + 1), sg;
+#pragma omp parallel for schedule(dynamic)
+	for (sg = 0; sg < segs; ++sg) {
+		uLL lo = sg * segment_numbers, hi = lo + segment_numbers < limit + 1 ? lo + segment_numbers : limit + 1;
+		segment_sieve s(lo, hi);
+		s.next_segment();
+		memcpy(&bits[lo / 128], &s.bits[0], (hi - lo + 127) / 128 * 8);
+	}
+	double sieved = omp_get_wtime();
+	rank_index r(&bits[0], bits.size());
+	double built = omp_get_wtime();
+	cout << "Sieve: " << sieved - start << ", rank index: " << built - sieved << " ("
+	     << (r.counts.size() + r.samples.size()) * 8 << " bytes over " << bits.size() * 8 << ")" << endl;
+
+	auto pi = [&](uLL x) { return x < 2 ? 0 : 1 + r.rank(x / 2 + (x & 1)); };		// odd n <= x, + the 2
+	auto nth = [&](uLL k) { return k == 1 ? 2 : 2 * r.select(k - 2) + 1; };
+
+	const char *name;
+	popcount_kernel kernels[] = { popcount_words_generic, popcount_words_popcnt, popcount_words_avx512 };
+	select_popcount(&name);
+	cout << "Popcount kernel: " << name << ", rank / select: " << (bits_hw_ok() ? "popcnt + pdep" : "portable") << endl;
+	for (int k = 0; k < 3; ++k) {
+		if ((k == 1 && !bits_hw_ok()) || (k == 2 && !__builtin_cpu_supports("avx512vpopcntdq")))
+			continue;
+		start = omp_get_wtime();
+		uLL c = kernels[k](&bits[0], bits.size());
+		double t = omp_get_wtime() - start;
+		cout << "  " << (k == 0 ? "scalar" : k == 1 ? "popcnt" : "AVX-512") << ": " << c + 1 << " primes, "
+		     << bits.size() * 8 / t / 1e9 << " GB/s" << endl;
+	}
+
+	// checks
+	int wrong = 0;
+	const uLL known[] = { 0, 4, 25, 168, 1229, 9592, 78498, 664579, 5761455, 50847534,
+			      455052511, 4118054813ULL, 37607912018ULL };	// pi(10^k)
+	for (uLL x = 1, k = 0; x <= limit && k < 13; x *= 10, ++k)
+		if (pi(x) != known[k]) {
+			cout << "pi(" << x << ") = " << pi(x) << " wrong" << endl;
+			++wrong;
+		}
+	mt19937_64 rng(5);
+	for (int q = 0; q < 2000; ++q) {
+		uLL i = rng() % (nbits + 1);
+		uLL lin = popcount_range(&bits[0], 0, i);
+		uLL slow = 0;
+		for (uLL w = 0; w < i / 64; ++w)
+			slow += bits_generic::pop(bits[w]);
+		if (i % 64)
+			slow += bits_generic::pop(bits[i / 64] & ((1ULL << (i % 64)) - 1));
+		if (r.rank(i) != slow || lin != slow)
+			++wrong;
+		if (slow < r.ones) {
+			uLL p = r.select(slow);	// first one at or after i
+			uLL expect = i;
+			while (!(bits[expect / 64] >> (expect % 64) & 1))
+				++expect;
+			if (p != expect)
+				++wrong;
+		}
+	}
+	cout << "Checks: " << wrong << " wrong" << endl;
+
+	// timings
+	vector<uLL> x(queries), y(queries), k(queries);
+	for (int q = 0; q < queries; ++q) {
+		x[q] = rng() % limit;
+		y[q] = x[q] + rng() % (limit - x[q]);
+		k[q] = 1 + rng() % (r.ones + 1);
+	}
+	uLL sum = 0;
+	start = omp_get_wtime();
+	for (int q = 0; q < queries; ++q)
+		sum += pi(y[q]) - pi(x[q]);
+	double t_count = omp_get_wtime() - start;
+	start = omp_get_wtime();
+	for (int q = 0; q < queries; ++q)
+		sum += nth(k[q]);
+	double t_nth = omp_get_wtime() - start;
+	cout << "count in range: " << t_count / queries * 1e9 << " ns, nth prime: " << t_nth / queries * 1e9
+	     << " ns per query (" << sum % 10 << ")" << endl;
+
+	// what the bool tables do: one entry at a time, and the k-th prime by walking
+	uLL n = limit < 100000000 ? limit : 100000000;
+	bool *flags = new bool[n + 1];
+	for (uLL i = 0; i <= n; ++i)
+		flags[i] = i == 2 || ((i & 1) && (bits[i / 128] >> (i / 2 % 64) & 1));
+	start = omp_get_wtime();
+	uLL c1 = 0;
+	for (uLL i = 0; i <= n; ++i)
+		c1 += flags[i];
+	double t_loop = omp_get_wtime() - start;
+	start = omp_get_wtime();
+	uLL c2 = count_flags(flags, n + 1);
+	double t_flags = omp_get_wtime() - start;
+	start = omp_get_wtime();
+	uLL walked = 0, seen = 0, target = c1 / 2;
+	for (uLL i = 0; i <= n && seen < target; ++i)
+		if (flags[i] && ++seen == target)
+			walked = i;
+	double t_walk = omp_get_wtime() - start;
+	cout << "bool table of " << n << ": count " << c1 << " entry by entry " << t_loop << " s, count_flags "
+	     << c2 << " " << t_flags << " s; prime " << target << " by walking " << walked << " in " << t_walk
+	     << " s, select " << nth(target) << endl;
+	delete[] flags;
+	return wrong ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+/* counting over bit-packed sieves with the hardware popcount, and rank / select
+
+   popcount_words  - ones of a word array: popcnt, or AVX-512 VPOPCNTDQ 8 words at a time
+   popcount_range  - ones of bits [a, b)
+   count_flags     - true entries of a bool array, 8 at a time (a bool is 0 or 1, so the
+                     popcount of 8 of them read as a word is their sum)
+   rank_index      - rank(i) in O(1): per block of 8 words the ones before it (64 bits)
+                     and 7 x 9-bit counts inside it (64 bits), 25% over the bitmap;
+                     select(k) from a sample every select_sample ones, then the block
+                     counts and pdep inside the word
+
+   everything picks popcnt / bmi2 / AVX-512 at run time and falls back to portable code;
+   the query bodies are templates on the word operations, instantiated once per ISA */
+
+#ifndef PR2_RANK_SELECT_H
+#define PR2_RANK_SELECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include <immintrin.h>
+
+typedef unsigned long long uLL;
+
+/* word operations - portable */
+
+struct bits_generic {
+	static unsigned pop(uint64_t w) { return __builtin_popcountll(w); }
+
+	/* position of set bit number k (from 0) of w, k < pop(w) */
+	static unsigned select(uint64_t w, unsigned k) {
+		unsigned pos = 0;
+		for (;;) {
+			unsigned c = pop(w & 0xff);
+			if (k < c)
+				break;
+			k -= c;
+			w >>= 8;
+			pos += 8;
+		}
+		while (k--)
+			w &= w - 1;
+		return pos + __builtin_ctzll(w);
+	}
+};
+
+/* popcnt and pdep */
+
+struct bits_hw {
+	__attribute__((target("popcnt"))) static unsigned pop(uint64_t w) { return __builtin_popcountll(w); }
+
+	__attribute__((target("popcnt,bmi2"))) static unsigned select(uint64_t w, unsigned k) {
+		return __builtin_ctzll(_pdep_u64(1ULL << k, w));
+	}
+};
+
+inline bool bits_hw_ok() {
+	static const bool ok = (__builtin_cpu_init(), __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi2"));
+	return ok;
+}
+
+inline unsigned popcount64(uint64_t w) {
+	return bits_hw_ok() ? bits_hw::pop(w) : bits_generic::pop(w);
+}
+
+inline unsigned select64(uint64_t w, unsigned k) {
+	return bits_hw_ok() ? bits_hw::select(w, k) : bits_generic::select(w, k);
+}
+
+/* bulk counting */
+
+template <class B> inline uLL popcount_words_in(const uint64_t *w, size_t n) {
+	uLL c = 0;
+	for (size_t i = 0; i < n; ++i)
+		c += B::pop(w[i]);
+	return c;
+}
+
+inline uLL popcount_words_generic(const uint64_t *w, size_t n) {
+	return popcount_words_in<bits_generic>(w, n);
+}
+
+__attribute__((target("popcnt,bmi2"), flatten))
+inline uLL popcount_words_popcnt(const uint64_t *w, size_t n) {
+	return popcount_words_in<bits_hw>(w, n);
+}
+
+__attribute__((target("popcnt,avx512f,avx512vpopcntdq")))
+inline uLL popcount_words_avx512(const uint64_t *w, size_t n) {
+	__m512i acc = _mm512_setzero_si512();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512((const void *) (w + i))));
+	uint64_t lanes[8];
+	_mm512_storeu_si512((void *) lanes, acc);
+	uLL c = 0;
+	for (int j = 0; j < 8; ++j)
+		c += lanes[j];
+	for (; i < n; ++i)
+		c += __builtin_popcountll(w[i]);
+	return c;
+}
+
+typedef uLL (*popcount_kernel)(const uint64_t *, size_t);
+
+inline popcount_kernel select_popcount(const char **name = 0) {
+	const char *dummy;
+	if (!name)
+		name = &dummy;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("popcnt")) {
+		*name = "AVX-512 VPOPCNTDQ";
+		return popcount_words_avx512;
+	}
+	if (bits_hw_ok()) {
+		*name = "popcnt";
+		return popcount_words_popcnt;
+	}
+	*name = "scalar";
+	return popcount_words_generic;
+}
+
+inline uLL popcount_words(const uint64_t *w, size_t n) {
+	static const popcount_kernel kernel = select_popcount();
+	return kernel(w, n);
+}
+
+/* ones of bits [a, b) */
+
+inline uLL popcount_range(const uint64_t *bits, uLL a, uLL b) {
+	if (a >= b)
+		return 0;
+	uLL wa = a / 64, wb = b / 64;
+	if (wa == wb)
+		return popcount64(bits[wa] >> (a % 64) & ((1ULL << (b - a)) - 1));
+	uLL c = popcount64(bits[wa] >> (a % 64)) + popcount_words(bits + wa + 1, wb - wa - 1);
+	if (b % 64)
+		c += popcount64(bits[wb] & ((1ULL << (b % 64)) - 1));
+	return c;
+}
+
+/* true entries of flags[0, n) */
+
+template <class B> inline uLL count_flags_in(const bool *flags, uLL n) {
+	uLL c = 0, i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t w;
+		memcpy(&w, flags + i, 8);
+		c += B::pop(w);
+	}
+	for (; i < n; ++i)
+		c += flags[i];
+	return c;
+}
+
+__attribute__((target("popcnt,bmi2"), flatten))
+inline uLL count_flags_popcnt(const bool *flags, uLL n) {
+	return count_flags_in<bits_hw>(flags, n);
+}
+
+inline uLL count_flags(const bool *flags, uLL n) {
+	return bits_hw_ok() ? count_flags_popcnt(flags, n) : count_flags_in<bits_generic>(flags, n);
+}
+
+const uLL select_sample = 512;	// ones between the select samples
+
+struct rank_index {
+	const uint64_t *bits;
+	uLL words;
+	std::vector<uint64_t> counts;	// 2 per block of 8 words (+ 1 block with the total)
+	std::vector<uLL> samples;	// block of the ones 0, select_sample, 2 select_sample, ..
+	uLL ones;
+
+	rank_index() : bits(NULL), words(0), ones(0) {}
+	rank_index(const uint64_t *b, uLL w) { build(b, w); }
+
+	/* the bitmap has to stay where it is while the index is used */
+	void build(const uint64_t *b, uLL w) {
+		bits = b;
+		words = w;
+		uLL blocks = w / 8 + 1;
+		counts.assign(2 * blocks, 0);
+		samples.clear();
+		uLL total = 0, next_sample = 0;
+		for (uLL k = 0; k < blocks; ++k) {
+			uint64_t packed = 0;
+			uLL rel = 0;
+			for (uLL j = 0; j < 8; ++j) {
+				if (j)
+					packed |= rel << (9 * (j - 1));
+				if (8 * k + j < w)
+					rel += popcount64(b[8 * k + j]);
+			}
+			counts[2 * k] = total;
+			counts[2 * k + 1] = packed;
+			total += rel;
+			for (; next_sample < total; next_sample += select_sample)
+				samples.push_back(k);
+		}
+		ones = total;
+		if (w % 8 == 0)
+			return;
+		counts.push_back(total);	// the total as a block of its own
+		counts.push_back(0);
+	}
+
+	uLL rank(uLL i) const;		// ones in bits [0, i), i <= 64 words
+	uLL select(uLL k) const;	// position of one number k (from 0), k < ones
+};
+
+template <class B> inline uLL rank_in(const rank_index &x, uLL i) {
+	uLL w = i / 64, k = w / 8, j = w % 8;
+	uLL r = x.counts[2 * k];
+	if (j)
+		r += x.counts[2 * k + 1] >> (9 * (j - 1)) & 511;
+	if (i % 64)
+		r += B::pop(x.bits[w] & ((1ULL << (i % 64)) - 1));
+	return r;
+}
+
+template <class B> inline uLL select_in(const rank_index &x, uLL k) {
+	uLL b = x.samples[k / select_sample];
+	while (x.counts[2 * (b + 1)] <= k)
+		++b;
+	uLL r = k - x.counts[2 * b];
+	uint64_t packed = x.counts[2 * b + 1];
+	uLL j = 0, before = 0;
+	while (j < 7 && (packed >> (9 * j) & 511) <= r)
+		before = packed >> (9 * j++) & 511;
+	return 64 * (8 * b + j) + B::select(x.bits[8 * b + j], (unsigned) (r - before));
+}
+
+__attribute__((target("popcnt,bmi2"), flatten))
+inline uLL rank_hw(const rank_index &x, uLL i) {
+	return rank_in<bits_hw>(x, i);
+}
+
+__attribute__((target("popcnt,bmi2"), flatten))
+inline uLL select_hw(const rank_index &x, uLL k) {
+	return select_in<bits_hw>(x, k);
+}
+
+inline uLL rank_index::rank(uLL i) const {
+	return bits_hw_ok() ? rank_hw(*this, i) : rank_in<bits_generic>(*this, i);
+}
+
+inline uLL rank_index::select(uLL k) const {
+	return bits_hw_ok() ? select_hw(*this, k) : select_in<bits_generic>(*this, k);
+}
+
+/* positions base + step * i of the set bits i of bits[0, words) into out, in order
+   (a tzcnt loop per word); returns the number written */
+
+template <class T> inline size_t decode_bits(const uint64_t *bits, size_t words, uLL base, uLL step, T *out) {
+	size_t n = 0;
+	for (size_t i = 0; i < words; ++i)
+		for (uint64_t w = bits[i]; w; w &= w - 1)
+			out[n++] = (T) (base + step * (64 * i + __builtin_ctzll(w)));
+	return n;
+}
+
+#endif
@@ -0,0 +1,241 @@
+/* segmented sieve of Eratosthenes - shared by the pr2 programs */
+
+#ifndef PR2_SIEVE_H
+#define PR2_SIEVE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "presieve.h"
+#include "rank_select.h"
+
+typedef unsigned long long uLL;
+
+/* numbers per segment - odd ones only are stored, so 2^20 bits = 128 KB (fits L2) */
+const uLL segment_numbers = 1 << 21;
+
+/* floor(sqrt(n)) without the rounding errors of double */
+
+inline uLL isqrt(uLL n) {
+	uLL r = (uLL) sqrtl((long double) n);
+	while (r > 0 && r > n / r)
+		--r;
+	while ((r + 1) <= n / (r + 1))
+		++r;
+	return r;
+}
+
+/* floor(cbrt(n)) */
+
+inline uLL icbrt(uLL n) {
+	uLL r = (uLL) cbrtl((long double) n);
+	while (r > 0 && r > n / r / r)
+		--r;
+	while ((r + 1) <= n / (r + 1) / (r + 1))
+		++r;
+	return r;
+}
+
+/* primes up to limit (inclusive) - plain sieve, used as base primes of the segments */
+
+inline std::vector<unsigned> small_primes(unsigned limit) {
+	std::vector<unsigned> primes;
+	if (limit < 2)
+		return primes;
+	std::vector<char> tab(limit / 2 + 1, 1);	// tab[i] <-> 2i+1
+	primes.push_back(2);
+	for (uLL i = 3; i <= limit; i += 2) {
+		if (tab[i / 2]) {
+			primes.push_back((unsigned) i);
+			for (uLL j = i * i; j <= limit; j += 2 * i)
+				tab[j / 2] = 0;
+		}
+	}
+	return primes;
+}
+
+/* upper bounds on the number of primes, to size buffers without counting:
+   pi(x) < 1.25506 x / ln x (Rosser, Schoenfeld) and pi(x + y) - pi(x) <= 2 y / ln y
+   (Montgomery, Vaughan), for any x */
+
+inline uLL pi_upper(uLL x) {
+	if (x < 17)
+		return x < 2 ? 0 : 7;
+	return (uLL) (1.25506 * x / logl((long double) x)) + 1;
+}
+
+inline uLL interval_primes_upper(uLL y) {
+	if (y < 16)
+		return y / 2 + 2;
+	return (uLL) (2 * y / logl((long double) y)) + 1;
+}
+
+const uLL base_chunk = 1 << 16;	// odd numbers per chunk when the base primes are extended
+
+/* first odd multiple of the odd p at or above low; ~0 (odd, never inside a range, which
+   ends at 2^64 - 1 exclusive) when there is none below 2^64 */
+
+inline uLL first_odd_multiple(uLL low, uLL p) {
+	uLL r = low % p;
+	uLL d = r ? p - r : 0;
+	if (d > ~0ULL - low)
+		return ~0ULL;
+	uLL j = low + d;
+	if (!(j & 1)) {
+		if (p > ~0ULL - j)
+			return ~0ULL;
+		j += p;
+	}
+	return j;
+}
+
+/* sieve of [start, stop) one segment at a time; bit i of a segment <-> low + 2i + 1,
+   set bits are the odd primes of the segment (2 is left to the caller); the base
+   primes are added as the segments go up, so an open range (stop = ~0) costs only
+   the primes up to sqrt of the current segment */
+
+struct segment_sieve {
+	uLL start, stop;
+	uLL low, high;			// current segment [low, high), low is even
+	uLL size;
+	std::vector<uint64_t> bits;
+	std::vector<unsigned> primes;	// odd base primes up to base_limit
+	std::vector<uLL> next;		// next odd multiple to cross off, per base prime
+	uLL base_limit;
+
+	segment_sieve(uLL start_, uLL stop_, uLL size_ = segment_numbers)
+		: start(start_), stop(stop_), low(0), high(start_ & ~1ULL), size(size_), base_limit(2) {
+		bits.resize(size / 128 + 1);
+	}
+
+	/* base primes up to at least limit - doubled each time, capped by sqrt(stop); only
+	   (base_limit, to] is sieved, a chunk at a time, so the extension needs the primes
+	   up to sqrt(to) and one chunk besides the base itself */
+	void extend_base(uLL limit) {
+		uLL to = 2 * base_limit;
+		uLL cap = isqrt(stop - 1);
+		if (to > cap)
+			to = cap;
+		if (to < limit)
+			to = limit;
+		if (to > 0xffffffffULL)
+			to = 0xffffffffULL;
+		if (primes.capacity() < pi_upper(to)) {
+			primes.reserve(pi_upper(to));
+			next.reserve(pi_upper(to));
+		}
+		std::vector<unsigned> small = small_primes((unsigned) isqrt(to));
+		std::vector<char> tab(base_chunk);	// tab[i] <-> a + 2i
+		for (uLL a = (base_limit + 1) | 1; a <= to; a += 2 * base_chunk) {
+			uLL n = (to - a) / 2 + 1 < base_chunk ? (to - a) / 2 + 1 : base_chunk;
+			memset(&tab[0], 1, n);
+			for (size_t i = 1; i < small.size(); ++i) {
+				uLL q = small[i];
+				uLL j = q * q;
+				if (j < a) {
+					j = (a + q - 1) / q * q;
+					if (!(j & 1))
+						j += q;
+				}
+				for (; j < a + 2 * n; j += 2 * q)
+					tab[(j - a) / 2] = 0;
+			}
+			for (uLL i = 0; i < n; ++i) {
+				if (!tab[i])
+					continue;
+				uLL p = a + 2 * i;
+				uLL j = p * p;
+				if (j < low)
+					j = first_odd_multiple(low, p);
+				primes.push_back((unsigned) p);
+				next.push_back(j);
+			}
+		}
+		base_limit = to;
+	}
+
+	/* room for every base prime the range needs at once, so the base is never
+	   reallocated (a budget counts it once, not old + new copy) */
+	void reserve_base() {
+		uLL n = pi_upper(stop > 1 ? isqrt(stop - 1) : 0);
+		primes.reserve(n);
+		next.reserve(n);
+	}
+
+	/* bytes this sieve holds at most: segment, base primes up to sqrt(stop), and what
+	   extend_base needs on the side */
+	static uLL memory(uLL stop, uLL size = segment_numbers) {
+		uLL base = stop > 1 ? isqrt(stop - 1) : 0;
+		return (size / 128 + 1) * 8 + pi_upper(base) * (sizeof(unsigned) + sizeof(uLL))
+		       + base_chunk + pi_upper(isqrt(base)) * sizeof(unsigned);
+	}
+
+	/* sieves the next segment, false when the range is exhausted */
+	bool next_segment() {
+		if (high >= stop)
+			return false;
+		low = high;
+		high = stop - low > size ? low + size : stop;
+		uLL n = (high - low) / 2;	// odd numbers in [low, high)
+		size_t words = (n + 63) / 64;
+		presieve(low, &bits[0], words);		// 3..61 by patterns
+		if (n % 64)
+			bits[words - 1] &= (1ULL << (n % 64)) - 1;
+		for (size_t i = words; i < bits.size(); ++i)
+			bits[i] = 0;
+		if (base_limit < isqrt(high - 1))
+			extend_base(isqrt(high - 1));
+		for (size_t i = 0; i < primes.size(); ++i) {
+			uLL p = primes[i];
+			if (p * p >= high)
+				break;
+			if (p <= presieve_max)
+				continue;
+			// by bit index, so the step past the last multiple cannot wrap above 2^64
+			uLL j = next[i];
+			if (j >= high)
+				continue;
+			uLL k = (j - low) / 2;
+			for (; k < n; k += p)
+				bits[k / 64] &= ~(1ULL << (k % 64));
+			next[i] = 2 * k + 1 > ~0ULL - low ? ~0ULL : low + 2 * k + 1;
+		}
+		if (low == 0)
+			bits[0] &= ~1ULL;			// 1 is not a prime
+		for (uLL v = low + 1; v < start && v < high; v += 2) {	// below the range
+			uLL k = (v - low) / 2;
+			bits[k / 64] &= ~(1ULL << (k % 64));
+		}
+		return true;
+	}
+
+	/* number of primes in the current segment (without 2) */
+	uLL count() const {
+		return popcount_words(&bits[0], bits.size());
+	}
+
+	/* calls f(p) for every prime of the current segment in increasing order */
+	template <class F> void each(F f) const {
+		for (size_t i = 0; i < bits.size(); ++i) {
+			uint64_t w = bits[i];
+			while (w) {
+				f(low + 2 * (i * 64 + __builtin_ctzll(w)) + 1);
+				w &= w - 1;
+			}
+		}
+	}
+};
+
+/* number of primes in [start, stop) */
+
+inline uLL count_primes(uLL start, uLL stop) {
+	uLL c = (start <= 2 && stop > 2) ? 1 : 0;
+	segment_sieve s(start, stop);
+	while (s.next_segment())
+		c += s.count();
+	return c;
+}
+
+#endif
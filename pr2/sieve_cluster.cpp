@@ -0,0 +1,278 @@
+/* the sieve as N worker processes: the coordinator hands out ranges over Unix sockets,
+   the workers send back counts or the primes as halved-gap varints (prime_stream.h),
+   the coordinator merges them in range order; when a worker dies its ranges go to
+   the others. Coordination cost = wall time - sieve time / workers, printed at the end
+
+   build: g++ -O2 -fopenmp sieve_cluster.cpp -o sieve_cluster
+   usage: ./sieve_cluster count limit workers [kill]
+          ./sieve_cluster stream limit workers out.bin [kill]
+          kill - worker 0 is killed after that many results (failure test) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <omp.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <iostream>
+
+#include "sieve.h"
+#include "prime_stream.h"
+
+using namespace std;
+
+const uLL cluster_range = 1 << 26;	// numbers per task
+const unsigned cluster_depth = 2;	// tasks in flight per worker
+const unsigned gap_bytes = 2;		// halved gaps below 2^14 - every gap of primes below 2^64
+
+struct task {
+	uLL id, lo, hi;
+	uint32_t stream;	// 1 - send the primes, 0 - the count only
+	uint32_t reserved;
+};
+
+struct reply {
+	uLL id, count;
+	uLL first;		// first prime of the range (stream)
+	uLL bytes;		// payload after the reply
+	double seconds;		// spent sieving
+};
+
+bool read_full(int fd, void *buf, size_t len) {
+	char *p = (char *) buf;
+	while (len) {
+		ssize_t r = read(fd, p, len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return false;
+		p += r;
+		len -= r;
+	}
+	return true;
+}
+
+bool write_full(int fd, const void *buf, size_t len) {
+	return write_all(fd, (const char *) buf, len);
+}
+
+/* worker process: tasks in, replies out, until the socket closes */
+
+void worker(int fd) {
+	task t;
+	vector<unsigned char> payload;
+	while (read_full(fd, &t, sizeof(t))) {
+		double start = omp_get_wtime();
+		reply r = { t.id, 0, 0, 0, 0 };
+		// room for the primes of the range (interval_primes_upper), grown if a gap needs more
+		payload.resize(t.stream ? interval_primes_upper(t.hi - t.lo) * gap_bytes + 16 : 0);
+		unsigned char *end = t.stream ? &payload[0] : NULL;
+		uLL prev = 0;
+		auto put = [&](uLL p) {
+			if (t.stream) {
+				if (r.count == 0)
+					r.first = p;
+				else {
+					size_t used = end - &payload[0];
+					if (payload.size() - used < 10) {
+						payload.resize(2 * payload.size());
+						end = &payload[0] + used;
+					}
+					end = put_gap(end, p - prev);
+				}
+				prev = p;
+			}
+			++r.count;
+		};
+		if (t.lo <= 2 && t.hi > 2)
+			put(2);
+		segment_sieve s(t.lo, t.hi);
+		while (s.next_segment()) {
+			if (t.stream)
+				s.each(put);
+			else
+				r.count += s.count();
+		}
+		r.bytes = t.stream ? end - &payload[0] : 0;
+		r.seconds = omp_get_wtime() - start;
+		if (!write_full(fd, &r, sizeof(r)) || (r.bytes && !write_full(fd, &payload[0], r.bytes)))
+			break;
+	}
+	close(fd);
+	_exit(0);
+}
+
+struct worker_state {
+	pid_t pid;
+	int fd;
+	bool alive;
+	deque<uLL> in_flight;	// task ids, in the order sent
+	uLL done;
+};
+
+struct result {
+	reply r;
+	vector<unsigned char> payload;
+};
+
+int main(int argc, char **argv) {
+	string mode = argc > 1 ? argv[1] : "";
+	bool stream = mode == "stream";
+	if ((mode != "count" && !stream) || argc < (stream ? 5 : 4)) {
+		cout << "usage: " << argv[0] << " count limit workers [kill]" << endl;
+		cout << "       " << argv[0] << " stream limit workers out.bin [kill]" << endl;
+		return 1;
+	}
+	uLL limit = strtoull(argv[2], NULL, 10);
+	int workers = atoi(argv[3]);
+	int kill_arg = stream ? 5 : 4;
+	uLL kill_after = argc > kill_arg ? strtoull(argv[kill_arg], NULL, 10) : 0;
+	if (workers < 1)
+		workers = 1;
+	signal(SIGPIPE, SIG_IGN);
+
+	double start = omp_get_wtime();
+	vector<worker_state> w(workers);
+	for (int i = 0; i < workers; ++i) {
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+			perror("socketpair");
+			return 1;
+		}
+		pid_t pid = fork();
+		if (pid == 0) {
+			close(sv[0]);
+			for (int j = 0; j < i; ++j)
+				close(w[j].fd);
+			worker(sv[1]);
+		}
+		close(sv[1]);
+		w[i].pid = pid;
+		w[i].fd = sv[0];
+		w[i].alive = pid > 0;
+		w[i].done = 0;
+	}
+
+	uLL tasks = limit / cluster_range + 1;
+	deque<uLL> todo;
+	for (uLL k = 0; k < tasks; ++k)
+		todo.push_back(k);
+	map<uLL, result> waiting;	// finished out of order
+	uLL next = 0, total = 0, received = 0, bytes = 0, reassigned = 0;
+	double sieve_seconds = 0;
+	prime_stream_writer out;
+	if (stream && !out.open(argv[4])) {
+		cerr << "cannot open " << argv[4] << endl;
+		return 1;
+	}
+
+	auto lost = [&](worker_state &x) {	// its tasks go back to the front of the queue
+		x.alive = false;
+		close(x.fd);
+		waitpid(x.pid, NULL, 0);
+		reassigned += x.in_flight.size();
+		while (!x.in_flight.empty()) {
+			todo.push_front(x.in_flight.back());
+			x.in_flight.pop_back();
+		}
+	};
+
+	while (next < tasks) {
+		// hand out work
+		for (int i = 0; i < workers; ++i)
+			while (w[i].alive && w[i].in_flight.size() < cluster_depth && !todo.empty()) {
+				uLL k = todo.front();
+				task t = { k, k * cluster_range, (k + 1) * cluster_range < limit + 1 ? (k + 1) * cluster_range : limit + 1, stream, 0 };
+				if (!write_full(w[i].fd, &t, sizeof(t))) {
+					lost(w[i]);
+					break;
+				}
+				todo.pop_front();
+				w[i].in_flight.push_back(k);
+			}
+		vector<pollfd> fds;
+		vector<int> who;
+		for (int i = 0; i < workers; ++i)
+			if (w[i].alive) {
+				pollfd p = { w[i].fd, POLLIN, 0 };
+				fds.push_back(p);
+				who.push_back(i);
+			}
+		if (fds.empty()) {
+			cerr << "all workers died" << endl;
+			return 1;
+		}
+		if (poll(&fds[0], fds.size(), -1) < 0 && errno != EINTR)
+			break;
+		for (size_t j = 0; j < fds.size(); ++j) {
+			if (!fds[j].revents)
+				continue;
+			worker_state &x = w[who[j]];
+			result res;
+			if (!read_full(x.fd, &res.r, sizeof(res.r))) {
+				lost(x);
+				continue;
+			}
+			res.payload.resize(res.r.bytes);
+			if (res.r.bytes && !read_full(x.fd, &res.payload[0], res.r.bytes)) {
+				lost(x);
+				continue;
+			}
+			for (deque<uLL>::iterator it = x.in_flight.begin(); it != x.in_flight.end(); ++it)
+				if (*it == res.r.id) {
+					x.in_flight.erase(it);
+					break;
+				}
+			++x.done;
+			++received;
+			bytes += sizeof(reply) + res.r.bytes;
+			sieve_seconds += res.r.seconds;
+			waiting[res.r.id].r = res.r;
+			waiting[res.r.id].payload.swap(res.payload);
+			if (kill_after && received == kill_after && w[0].alive) {
+				kill(w[0].pid, SIGKILL);
+				cerr << "killed worker 0 (pid " << w[0].pid << ")" << endl;
+			}
+		}
+		// merge whatever is now in order
+		for (map<uLL, result>::iterator it; (it = waiting.find(next)) != waiting.end(); ++next) {
+			const result &r = it->second;
+			total += r.r.count;
+			if (stream && r.r.count) {
+				uLL p = r.r.first;
+				out.put(p);
+				const unsigned char *q = r.payload.empty() ? NULL : &r.payload[0];
+				for (uLL c = 1; c < r.r.count; ++c) {
+					uLL gap;
+					q = get_gap(q, gap);
+					p += gap;
+					out.put(p);
+				}
+			}
+			waiting.erase(it);
+		}
+	}
+	for (int i = 0; i < workers; ++i)
+		if (w[i].alive) {
+			close(w[i].fd);
+			waitpid(w[i].pid, NULL, 0);
+		}
+	bool ok = !stream || out.close();
+	double wall = omp_get_wtime() - start;
+
+	cout << "pi(" << limit << ") = " << total << endl;
+	cout << workers << " workers, " << tasks << " ranges, " << reassigned << " reassigned, "
+	     << bytes << " bytes received" << endl;
+	for (int i = 0; i < workers; ++i)
+		cout << "  worker " << i << ": " << w[i].done << " ranges" << (w[i].alive ? "" : " (died)") << endl;
+	cout << "wall " << wall << ", sieving " << sieve_seconds << " (in the workers), coordination "
+	     << wall - sieve_seconds / workers << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+/* sieve and write at the same time: sieve threads fill segments k+1, k+2, ... while
+   the writer thread sends segment k to the file; a ring of slots bounds the memory
+
+   build: g++ -O2 -fopenmp sieve_pipeline.cpp -o sieve_pipeline
+   usage: ./sieve_pipeline limit out.txt [pipeline|plain|serial [budget]]
+          pipeline - io_uring writes (pwrite when the kernel has no io_uring)
+          plain    - pipeline with pwrite
+          serial   - sieve everything first, then write (the pr2 way)
+          budget   - memory cap ("512M"; PR2_MEMORY, the cgroup limit): the
+                     sievers, slots and segments are sized to fit (memory_budget.h) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "sieve.h"
+#include "prime_writer.h"
+#include "io_ring.h"
+#include "memory_budget.h"
+
+using namespace std;
+
+const uLL pipeline_segment = 1 << 23;	// numbers per slot
+const unsigned ring_depth = 4;		// writes in flight
+
+struct slot {
+	vector<char> text;
+	size_t len;
+	uLL offset;	// in the file
+	uLL next;	// segment allowed into the slot
+	bool ready;	// sieved and formatted, waiting for the writer
+};
+
+/* primes of slot k of [0, limit] as text */
+
+size_t sieve_segment(uLL k, uLL limit, const sieve_plan &plan, vector<char> &text) {
+	uLL lo = k * plan.slot;
+	uLL hi = lo + plan.slot < limit + 1 ? lo + plan.slot : limit + 1;
+	if (text.size() < plan.slot_bytes)
+		text.resize(plan.slot_bytes);
+	char *p = &text[0];
+	if (lo <= 2 && hi > 2)
+		p += format_line(2, p);
+	segment_sieve s(lo, hi, plan.segment);
+	s.reserve_base();
+	while (s.next_segment())
+		s.each([&](uLL q) { p += format_line(q, p); });
+	return p - &text[0];
+}
+
+bool pipeline(uLL limit, int fd, bool uring, const sieve_plan &plan, uLL &bytes, double &seconds) {
+	uLL segments = limit / plan.slot + 1;
+	int sievers = plan.threads;
+	unsigned depth = (unsigned) plan.slots;	// slots: sieving + waiting + in flight
+	vector<slot> slots(depth);
+	for (unsigned i = 0; i < depth; ++i) {
+		slots[i].next = i;
+		slots[i].ready = false;
+	}
+	mutex m;
+	condition_variable changed;
+	uLL taken = 0;
+	io_ring ring;
+	if (uring && !ring.init(ring_depth)) {
+		cerr << "io_uring not available, using pwrite" << endl;
+		uring = false;
+	}
+	bool ok = true;
+	bool failed = false;	// the ring broke or a siever ran out of memory - everybody stops (under m)
+	bool no_memory = false;
+	bytes = 0;
+
+	double start = omp_get_wtime();
+#pragma omp parallel num_threads(sievers + 1)
+	{
+		if (omp_get_thread_num() == 0) {
+			// writer: segments in order, slot freed when its write completes
+			unsigned in_flight = 0;
+			uLL offset = 0;
+			auto release = [&](uLL k) {
+				lock_guard<mutex> l(m);
+				slots[k % depth].ready = false;
+				slots[k % depth].next = k + depth;
+				changed.notify_all();
+			};
+			// one completion; false when the ring itself fails - then nothing in flight
+			// will be seen again, the pipeline stops (the ring is closed before the slots
+			// go away, which cancels what is left)
+			auto reap = [&]() {
+				uint64_t k;
+				int res;
+				if (!ring.wait(k, res)) {
+					ok = false;
+					in_flight = 0;
+					lock_guard<mutex> l(m);
+					failed = true;
+					changed.notify_all();
+					return false;
+				}
+				slot &s = slots[k % depth];
+				if (res < 0)
+					ok = false;
+				else if ((size_t) res < s.len)	// short write - finish it directly
+					ok = pwrite_all(fd, &s.text[res], s.len - res, (off_t) (s.offset + res)) && ok;
+				--in_flight;
+				release(k);
+				return true;
+			};
+			auto slot_free = [&](uLL k) {
+				lock_guard<mutex> l(m);
+				return slots[k % depth].next == k;
+			};
+			for (uLL k = 0; k < segments; ++k) {
+				slot &s = slots[k % depth];
+				// the write of k - depth frees the slot, the completions come in any order
+				while (in_flight && !slot_free(k) && reap())
+					;
+				{
+					unique_lock<mutex> l(m);
+					changed.wait(l, [&] { return failed || (s.ready && s.next == k); });
+					if (failed)
+						break;
+				}
+				s.offset = offset;
+				offset += s.len;	// the slot is refilled as soon as it is released
+				if (uring && in_flight == ring_depth && !reap())
+					break;
+				if (uring && ring.write(fd, &s.text[0], (unsigned) s.len, s.offset, k))
+					++in_flight;
+				else {		// plain, or no room in the ring
+					ok = pwrite_all(fd, &s.text[0], s.len, (off_t) s.offset) && ok;
+					release(k);
+				}
+			}
+			while (in_flight && reap())
+				;
+			bytes = offset;
+		}
+		else {
+			for (;;) {
+				uLL k;
+				{
+					lock_guard<mutex> l(m);
+					k = taken++;
+				}
+				if (k >= segments)
+					break;
+				slot &s = slots[k % depth];
+				{
+					unique_lock<mutex> l(m);
+					changed.wait(l, [&] { return failed || (s.next == k && !s.ready); });
+					if (failed)
+						break;
+				}
+				size_t len;
+				try {	// nothing may leave the parallel region
+					len = sieve_segment(k, limit, plan, s.text);
+				}
+				catch (const bad_alloc &) {
+					lock_guard<mutex> l(m);
+					failed = no_memory = true;
+					changed.notify_all();
+					break;
+				}
+				lock_guard<mutex> l(m);
+				s.len = len;
+				s.ready = true;
+				changed.notify_all();
+			}
+		}
+	}
+	double stop = omp_get_wtime();
+	if (no_memory)
+		throw bad_alloc();	// for main, now that every thread is out
+	seconds = stop - start;
+	return ok;
+}
+
+/* all segments sieved first (parallel), then written (the timer keeps running) */
+
+bool serial(uLL limit, int fd, const sieve_plan &plan, uLL &bytes, double &seconds) {
+	uLL segments = limit / plan.slot + 1;
+	vector<vector<char> > text(segments);
+	vector<size_t> len(segments);
+	double start = omp_get_wtime();
+	long long k;
+	vector<vector<char> > buf(omp_get_max_threads());
+	atomic<bool> no_memory(false);
+#pragma omp parallel for schedule(dynamic)
+	for (k = 0; k < (long long) segments; ++k) {
+		if (no_memory)
+			continue;
+		vector<char> &b = buf[omp_get_thread_num()];
+		try {
+			len[k] = sieve_segment(k, limit, plan, b);
+			text[k].assign(b.begin(), b.begin() + len[k]);
+		}
+		catch (const bad_alloc &) {
+			no_memory = true;
+		}
+	}
+	if (no_memory)
+		throw bad_alloc();
+	double sieved = omp_get_wtime();
+	bytes = 0;
+	bool ok = true;
+	for (k = 0; k < (long long) segments && ok; ++k) {
+		ok = write_all(fd, &text[k][0], len[k]);
+		if (ok)
+			bytes += len[k];
+	}
+	double stop = omp_get_wtime();
+	cout << "sieve " << sieved - start << " + write " << stop - sieved << endl;
+	seconds = stop - start;
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		cout << "usage: " << argv[0] << " limit out.txt [pipeline|plain|serial [budget]]" << endl;
+		return 1;
+	}
+	uLL limit = strtoull(argv[1], NULL, 10);
+	string mode = argc > 3 ? argv[3] : "pipeline";
+	uLL budget;
+	if (!memory_budget(argc > 4 ? argv[4] : NULL, budget)) {
+		cerr << "the budget " << (argc > 4 ? argv[4] : getenv("PR2_MEMORY"))
+		     << " is not a size (bytes, or a number with K, M or G)" << endl;
+		return 1;
+	}
+	if (budget > physical_bytes()) {
+		cerr << "a budget of " << (budget >> 20) << " MB is more than the " << (physical_bytes() >> 20)
+		     << " MB of this machine" << endl;
+		return 1;
+	}
+	// pipeline: 2 slots per siever + ring_depth; serial: a buffer per thread, and the
+	// text of every prime kept until the end
+	bool keep = mode == "serial";
+	sieve_plan plan = plan_sieve(budget, limit + 1, omp_get_max_threads(), pipeline_segment, max_line,
+				     keep ? 1 : 2, keep ? 0 : ring_depth);
+	if (keep) {
+		plan.total += pi_upper(limit) * max_line;
+		plan.ok = !budget || plan.total <= budget;
+	}
+	print_plan(plan, cout);
+	if (!plan.ok) {
+		cerr << "a budget of " << (budget >> 20) << " MB is too small, " << mode << " needs about "
+		     << (plan.total >> 20) << " MB" << endl;
+		return 1;
+	}
+	if (budget && !limit_memory(budget, plan.threads + 1))
+		cerr << "cannot set RLIMIT_DATA, the budget is not enforced" << endl;
+	int fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		cerr << "cannot open " << argv[2] << endl;
+		return 1;
+	}
+	uLL bytes = 0;
+	double t = 0;
+	bool ok;
+	try {
+		if (mode == "serial")
+			ok = serial(limit, fd, plan, bytes, t);
+		else
+			ok = pipeline(limit, fd, mode == "pipeline", plan, bytes, t);
+	}
+	catch (const bad_alloc &) {
+		close(fd);
+		cerr << "out of memory under the budget of " << (budget >> 20) << " MB" << endl;
+		return 1;
+	}
+	ok = close(fd) == 0 && ok;
+	if (!ok) {
+		cerr << "writing " << argv[2] << " failed" << endl;
+		return 1;
+	}
+	cout << "Sieve + write (" << mode << "): " << t << ", " << bytes << " bytes, peak resident "
+	     << (peak_resident_bytes() >> 20) << " MB" << endl;
+	return 0;
+}
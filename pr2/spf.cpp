@@ -0,0 +1,125 @@
+/* batch factorization with the smallest prime factor table (spf.h) against trial
+   division by the primes up to sqrt (the division_sequential() way)
+
+   build: g++ -O2 -fopenmp spf.cpp -o spf
+   usage: ./spf limit [count]        count random n <= limit (default 10^7)
+          ./spf limit factor n ...   factors of the given n */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <string>
+#include <new>
+#include <stdexcept>
+
+#include "sieve.h"
+#include "spf.h"
+
+using namespace std;
+
+/* trial division, factors into out */
+
+unsigned trial_factor(uLL n, const vector<unsigned> &primes, uLL *out) {
+	unsigned k = 0;
+	for (size_t i = 0; i < primes.size(); ++i) {
+		uLL p = primes[i];
+		if (p * p > n)
+			break;
+		while (n % p == 0) {
+			out[k++] = p;
+			n /= p;
+		}
+	}
+	if (n > 1)
+		out[k++] = n;
+	return k;
+}
+
+template <class T> bool run(uLL limit, int argc, char **argv) {
+	spf_table<T> t;
+	double start = omp_get_wtime();
+	try {
+		t.build(limit);
+	} catch (const exception &) {	// bad_alloc or length_error
+		cout << "SPF table for " << limit << " needs " << spf_table<T>::megabytes(limit)
+		     << " MB - not enough memory" << endl;
+		return false;
+	}
+	double stop = omp_get_wtime();
+	cout << "SPF table (" << sizeof(T) * 8 << "-bit, " << t.spf.size() * sizeof(T) << " bytes): "
+	     << stop - start << endl;
+
+	if (argc > 2 && string(argv[2]) == "factor") {
+		for (int a = 3; a < argc; ++a) {
+			uLL n = strtoull(argv[a], NULL, 10), f[64];
+			if (n < 1 || n > limit) {
+				cout << n << ": out of the table" << endl;
+				continue;
+			}
+			unsigned k = t.factor(n, f);
+			cout << n << ":";
+			for (unsigned i = 0; i < k; ++i)
+				cout << " " << f[i];
+			cout << endl;
+		}
+		return true;
+	}
+
+	size_t count = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+	vector<uLL> n(count);
+	mt19937_64 rng(12345);
+	for (size_t i = 0; i < count; ++i)
+		n[i] = rng() % limit + 1;
+
+	vector<uLL> factors;
+	vector<size_t> offsets;
+	start = omp_get_wtime();
+	factor_batch(t, &n[0], count, factors, offsets);
+	stop = omp_get_wtime();
+	cout << "Batch of " << count << ": " << stop - start << " ("
+	     << (stop - start) / count * 1e9 << " ns per number, " << factors.size() << " factors)" << endl;
+
+	// trial division on a sample, checked against the table
+	vector<unsigned> primes = small_primes((unsigned) isqrt(limit));
+	size_t sample = count < 100000 ? count : 100000;
+	uLL f[64];
+	size_t errors = 0;
+	start = omp_get_wtime();
+	for (size_t i = 0; i < sample; ++i) {
+		unsigned k = trial_factor(n[i], primes, f);
+		if (k != offsets[i + 1] - offsets[i])
+			++errors;
+		else
+			for (unsigned j = 0; j < k; ++j)
+				if (f[j] != factors[offsets[i] + j])
+					++errors;
+	}
+	stop = omp_get_wtime();
+	cout << "Trial division of " << sample << ": " << stop - start << " ("
+	     << (stop - start) / sample * 1e9 << " ns per number), " << errors << " mismatches" << endl;
+	return errors == 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		cout << "usage: " << argv[0] << " limit [count]" << endl;
+		cout << "       " << argv[0] << " limit factor n ..." << endl;
+		return 1;
+	}
+	uLL limit = strtoull(argv[1], NULL, 10);
+	if (limit < 2) {
+		cout << "limit has to be at least 2" << endl;
+		return 1;
+	}
+	bool ok;
+	try {
+		ok = limit < (1ULL << 32) ? run<uint16_t>(limit, argc, argv) : run<uint32_t>(limit, argc, argv);
+	} catch (const exception &) {	// the batch vectors
+		cout << "not enough memory for the batch" << endl;
+		return 1;
+	}
+	return ok ? 0 : 1;
+}
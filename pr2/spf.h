@@ -0,0 +1,118 @@
+/* smallest prime factor table for the odd numbers <= limit and factorization with it
+
+   spf[i] <-> 2i + 1, 0 for 1 and the primes; the smallest factor of a composite is
+   <= sqrt(limit), so uint16_t entries are enough below 2^32 (1 byte per number)
+   and uint32_t above. The segments are sieved in parallel, the base primes go up in
+   order and only write an empty entry - the first one to come is the smallest */
+
+#ifndef PR2_SPF_H
+#define PR2_SPF_H
+
+#include <omp.h>
+#include <vector>
+
+#include "sieve.h"
+
+const uLL spf_segment = 1 << 19;	// numbers per segment, 2^18 entries
+
+template <class T> struct spf_table {
+	uLL limit;
+	std::vector<T> spf;
+
+	spf_table() : limit(0) {}
+
+	/* size of the table for limit in MB (rounded up) */
+	static uLL megabytes(uLL limit) { return ((limit / 2 >> 20) + 1) * sizeof(T); }
+
+	/* throws std::bad_alloc (std::length_error past the vector size limit) when the
+	   table does not fit */
+	void build(uLL limit_) {
+		limit = limit_;
+		spf.assign(limit / 2 + 1, 0);
+		std::vector<unsigned> base = small_primes((unsigned) isqrt(limit));
+		long long segments = (long long) (limit / spf_segment + 1);
+		long long s;
+#pragma omp parallel for schedule(dynamic)
+		for (s = 0; s < segments; ++s) {
+			uLL lo = s * spf_segment;
+			uLL hi = lo + spf_segment < limit + 1 ? lo + spf_segment : limit + 1;
+			for (size_t i = 1; i < base.size(); ++i) {
+				uLL p = base[i];
+				uLL j = p * p;
+				if (j >= hi)
+					break;
+				if (j < lo) {
+					j = (lo + p - 1) / p * p;
+					if (!(j & 1))
+						j += p;
+				}
+				for (; j < hi; j += 2 * p)
+					if (!spf[j / 2])
+						spf[j / 2] = (T) p;
+			}
+		}
+	}
+
+	/* smallest prime factor of 2 <= n <= limit */
+	uLL smallest(uLL n) const {
+		if (!(n & 1))
+			return 2;
+		T p = spf[n / 2];
+		return p ? p : n;
+	}
+
+	/* prime factors of 1 <= n <= limit with multiplicity, increasing; returns their number
+	   (at most 64) */
+	unsigned factor(uLL n, uLL *out) const {
+		unsigned k = 0;
+		unsigned twos = __builtin_ctzll(n);
+		for (; k < twos; ++k)
+			out[k] = 2;
+		n >>= twos;
+		while (n > 1) {
+			T p = spf[n / 2];
+			if (!p) {
+				out[k++] = n;
+				break;
+			}
+			out[k++] = p;
+			n /= p;
+		}
+		return k;
+	}
+
+	/* number of prime factors with multiplicity - first pass of the batch */
+	unsigned omega(uLL n) const {
+		unsigned k = __builtin_ctzll(n);
+		n >>= k;
+		while (n > 1) {
+			T p = spf[n / 2];
+			++k;
+			if (!p)
+				break;
+			n /= p;
+		}
+		return k;
+	}
+};
+
+/* factors of n[0..count) (all in 1..limit): the ones of n[i] are
+   factors[offsets[i] .. offsets[i + 1]) */
+
+template <class T> void factor_batch(const spf_table<T> &t, const uLL *n, size_t count,
+	std::vector<uLL> &factors, std::vector<size_t> &offsets) {
+	offsets.resize(count + 1);
+	long long i;
+#pragma omp parallel for schedule(static)
+	for (i = 0; i < (long long) count; ++i)
+		offsets[i + 1] = t.omega(n[i]);
+	offsets[0] = 0;
+	for (size_t j = 0; j < count; ++j)
+		offsets[j + 1] += offsets[j];
+	factors.resize(offsets[count]);
+#pragma omp parallel for schedule(static)
+	for (i = 0; i < (long long) count; ++i)
+		t.factor(n[i], &factors[offsets[i]]);
+}
+
+#endif
@@ -0,0 +1,179 @@
+/* trial division without the div instruction: for odd d and inv = d^-1 mod 2^32,
+   d divides n  <=>  n * inv mod 2^32 <= (2^32 - 1) / d
+   the AVX2 / AVX-512 kernels test 8 / 16 odd candidates against one divisor per
+   instruction; the kernel is picked at run time, scalar code is the fallback. The
+   kernels read a divisor_view - the arrays of a divisor_table built at run time, or the
+   constant ones of small_prime_table (prime_tables.h) */
+
+#ifndef PR2_TRIAL_DIVISION_H
+#define PR2_TRIAL_DIVISION_H
+
+#include <stdint.h>
+#include <vector>
+#include <immintrin.h>
+
+/* n^-1 mod 2^32 / 2^64 for odd n - Newton iteration, each step doubles the correct bits */
+
+constexpr uint32_t inverse32(uint32_t n) {
+	uint32_t x = n;		// correct to 3 bits
+	for (int i = 0; i < 4; ++i)
+		x *= 2 - n * x;
+	return x;
+}
+
+constexpr uint64_t inverse64(uint64_t n) {
+	uint64_t x = n;
+	for (int i = 0; i < 5; ++i)
+		x *= 2 - n * x;
+	return x;
+}
+
+/* odd base primes with their inverses and divisibility limits, as the kernels read them */
+
+struct divisor_view {
+	const uint32_t *p, *inv, *lim;
+	const uint64_t *inv64, *lim64;
+	size_t size;
+};
+
+/* the same in vectors, filled at run time */
+
+struct divisor_table {
+	std::vector<uint32_t> p, inv, lim;
+	std::vector<uint64_t> inv64, lim64;
+
+	divisor_table() {}
+
+	/* primes[] - flags of the primes up to sqrt of the largest tested number */
+	divisor_table(const bool *primes, uint32_t num) {
+		for (uint32_t j = 3; j <= num; j += 2)
+			if (primes[j])
+				add(j);
+	}
+
+	void add(uint32_t d) {
+		p.push_back(d);
+		inv.push_back(inverse32(d));
+		lim.push_back(0xffffffffu / d);
+		inv64.push_back(inverse64(d));
+		lim64.push_back(~0ULL / d);
+	}
+
+	operator divisor_view() const {
+		divisor_view v = { p.data(), inv.data(), lim.data(), inv64.data(), lim64.data(), p.size() };
+		return v;
+	}
+};
+
+/* scalar test, n < 2^32 */
+
+inline bool is_prime_inv(uint32_t n, const divisor_view &d) {
+	if (n < 2)
+		return false;
+	if (!(n & 1))
+		return n == 2;
+	for (size_t k = 0; k < d.size && (uint64_t) d.p[k] * d.p[k] <= n; ++k)
+		if (n * d.inv[k] <= d.lim[k])
+			return false;
+	return true;
+}
+
+/* scalar test for 64-bit n, the divisors must reach sqrt(n) */
+
+inline bool is_prime_inv64(uint64_t n, const divisor_view &d) {
+	if (n < 2)
+		return false;
+	if (!(n & 1))
+		return n == 2;
+	for (size_t k = 0; k < d.size && (uint64_t) d.p[k] * d.p[k] <= n; ++k)
+		if (n * d.inv64[k] <= d.lim64[k])
+			return false;
+	return true;
+}
+
+/* result[n] for n in [lo, hi) - scalar kernel */
+
+inline void trial_division_scalar(uint32_t lo, uint32_t hi, const divisor_view &d, bool *result) {
+	for (uint64_t n = lo; n < hi; ++n)
+		result[n] = is_prime_inv((uint32_t) n, d);
+}
+
+/* 8 odd candidates c, c+2, ..., c+14 per vector */
+
+__attribute__((target("avx2")))
+inline void trial_division_avx2(uint32_t lo, uint32_t hi, const divisor_view &d, bool *result) {
+	uint64_t n = lo;
+	for (; n < hi && (n < 64 || !(n & 1)); ++n)
+		result[n] = is_prime_inv((uint32_t) n, d);
+	const __m256i step = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+	for (; n + 16 <= hi; n += 16) {
+		__m256i c = _mm256_add_epi32(_mm256_set1_epi32((int) n), step);
+		__m256i composite = _mm256_setzero_si256();
+		uint64_t top = n + 14;
+		for (size_t k = 0; k < d.size && (uint64_t) d.p[k] * d.p[k] <= top; ++k) {
+			__m256i prod = _mm256_mullo_epi32(c, _mm256_set1_epi32((int) d.inv[k]));
+			__m256i lim = _mm256_set1_epi32((int) d.lim[k]);
+			composite = _mm256_or_si256(composite,
+				_mm256_cmpeq_epi32(_mm256_min_epu32(prod, lim), prod));
+			if ((k & 7) == 7 && _mm256_movemask_epi8(composite) == -1)
+				break;
+		}
+		unsigned mask = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(composite));
+		for (int i = 0; i < 8; ++i) {
+			result[n + 2 * i] = !((mask >> i) & 1);
+			result[n + 2 * i + 1] = false;
+		}
+	}
+	for (; n < hi; ++n)
+		result[n] = is_prime_inv((uint32_t) n, d);
+}
+
+/* 16 odd candidates per vector */
+
+__attribute__((target("avx512f")))
+inline void trial_division_avx512(uint32_t lo, uint32_t hi, const divisor_view &d, bool *result) {
+	uint64_t n = lo;
+	for (; n < hi && (n < 64 || !(n & 1)); ++n)
+		result[n] = is_prime_inv((uint32_t) n, d);
+	const __m512i step = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+	for (; n + 32 <= hi; n += 32) {
+		__m512i c = _mm512_add_epi32(_mm512_set1_epi32((int) n), step);
+		__mmask16 composite = 0;
+		uint64_t top = n + 30;
+		for (size_t k = 0; k < d.size && (uint64_t) d.p[k] * d.p[k] <= top; ++k) {
+			__m512i prod = _mm512_mullo_epi32(c, _mm512_set1_epi32((int) d.inv[k]));
+			composite |= _mm512_cmple_epu32_mask(prod, _mm512_set1_epi32((int) d.lim[k]));
+			if ((k & 7) == 7 && composite == 0xffff)
+				break;
+		}
+		for (int i = 0; i < 16; ++i) {
+			result[n + 2 * i] = !((composite >> i) & 1);
+			result[n + 2 * i + 1] = false;
+		}
+	}
+	for (; n < hi; ++n)
+		result[n] = is_prime_inv((uint32_t) n, d);
+}
+
+/* best kernel of this CPU */
+
+typedef void (*trial_division_kernel)(uint32_t, uint32_t, const divisor_view &, bool *);
+
+inline trial_division_kernel select_trial_division(const char **name = 0) {
+	const char *dummy;
+	if (!name)
+		name = &dummy;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		*name = "AVX-512";
+		return trial_division_avx512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		*name = "AVX2";
+		return trial_division_avx2;
+	}
+	*name = "scalar";
+	return trial_division_scalar;
+}
+
+#endif